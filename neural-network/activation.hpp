@@ -0,0 +1,386 @@
+//
+//  activation.hpp
+//  neural-network
+//
+//  Layer activation functions: sigmoid, tanh, ReLU, leaky ReLU, softmax and
+//  GELU. Each one works on a whole layer at a time (rows = neurons, columns
+//  = samples, row-major and contiguous), so the per-element work is a
+//  straight loop with no indirect call.
+//
+//  Derivatives are taken from the cached forward output a = f(z) wherever
+//  that is possible (sigmoid a(1 - a), tanh 1 - a^2, the ReLUs from the sign
+//  of a, softmax from its Jacobian-vector product), so the backward pass
+//  needs no second exp. Only GELU needs its input z kept.
+//
+//  The exp-based functions have two modes. Exact calls std::exp per
+//  element. Fast (setFastExp(true), or NN_FAST_EXP=1 in the environment)
+//  uses expFast below, a range-reduced polynomial with relative error under
+//  2e-7 in double (about 4 ulp in float), and runs sigmoid through AVX2
+//  kernels when the CPU has them. Tanh and GELU are both written in terms
+//  of sigmoid, so they share the same kernels.
+//
+
+#ifndef activation_hpp
+#define activation_hpp
+
+#include "matrix.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <bit>
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+
+namespace activation {
+
+enum class Function { Sigmoid, Tanh, ReLU, LeakyReLU, Softmax, GELU };
+
+// Slope of leaky ReLU for negative inputs
+constexpr double LEAKY_SLOPE = 0.01;
+
+inline const char* name(Function f) {
+    switch (f) {
+        case Function::Sigmoid: return "sigmoid";
+        case Function::Tanh: return "tanh";
+        case Function::ReLU: return "relu";
+        case Function::LeakyReLU: return "leaky_relu";
+        case Function::Softmax: return "softmax";
+        case Function::GELU: return "gelu";
+    }
+    return "unknown";
+}
+
+// True when the derivative can't be recovered from f(z) alone, so the
+// forward pass has to keep z for backprop
+inline bool needsInput(Function f) {
+    return f == Function::GELU;
+}
+
+inline bool& fastExpEnabled() {
+    static bool enabled = [] {
+        const char* env = std::getenv("NN_FAST_EXP");
+        return env != nullptr && std::strcmp(env, "0") != 0;
+    }();
+    return enabled;
+}
+
+// Not thread-safe: switch modes between, not during, computations
+inline void setFastExp(bool enabled) {
+    fastExpEnabled() = enabled;
+}
+
+// ---------------------------------------------------------------------------
+// Fast exp
+//
+// exp(x) = 2^k * exp(r) with k = round(x / ln 2) and |r| <= ln 2 / 2. exp(r)
+// is a degree-6 Taylor polynomial, whose truncation error on that interval
+// is below 1.7e-7 relative; 2^k is built directly in the exponent bits. x is
+// clamped to the finite range of T first.
+// ---------------------------------------------------------------------------
+
+template <typename T>
+struct ExpConstants;
+
+template <>
+struct ExpConstants<double> {
+    using Bits = std::int64_t;
+    static constexpr double MAX = 708.0;
+    static constexpr int MANTISSA = 52;
+    static constexpr Bits BIAS = 1023;
+};
+
+template <>
+struct ExpConstants<float> {
+    using Bits = std::int32_t;
+    static constexpr float MAX = 87.0f;
+    static constexpr int MANTISSA = 23;
+    static constexpr Bits BIAS = 127;
+};
+
+constexpr double LOG2E = 1.4426950408889634;
+constexpr double LN2_HI = 0.693145751953125;
+constexpr double LN2_LO = 1.4286068203094173e-06;
+
+template <typename T>
+inline T expFast(T x) {
+    using C = ExpConstants<T>;
+    x = std::clamp(x, -C::MAX, C::MAX);
+    const T k = std::nearbyint(x * T(LOG2E));
+    const T r = (x - k * T(LN2_HI)) - k * T(LN2_LO);
+    T p = T(1.0 / 720);
+    p = p * r + T(1.0 / 120);
+    p = p * r + T(1.0 / 24);
+    p = p * r + T(1.0 / 6);
+    p = p * r + T(0.5);
+    p = p * r + T(1);
+    p = p * r + T(1);
+    const auto bits = static_cast<typename C::Bits>(static_cast<typename C::Bits>(k) + C::BIAS) << C::MANTISSA;
+    return p * std::bit_cast<T>(bits);
+}
+
+template <typename T>
+inline T exp(T x) {
+    return fastExpEnabled() ? expFast(x) : std::exp(x);
+}
+
+// ---------------------------------------------------------------------------
+// Scalar functors, also usable with Matrix::apply
+// ---------------------------------------------------------------------------
+
+struct Sigmoid {
+    template <typename T> T operator()(T x) const { return T(1) / (T(1) + std::exp(-x)); }
+};
+struct Tanh {
+    template <typename T> T operator()(T x) const { return std::tanh(x); }
+};
+struct ReLU {
+    template <typename T> T operator()(T x) const { return x > T(0) ? x : T(0); }
+};
+struct LeakyReLU {
+    template <typename T> T operator()(T x) const { return x > T(0) ? x : T(LEAKY_SLOPE) * x; }
+};
+// tanh approximation: 0.5 x (1 + tanh(u)) = x * sigmoid(2u)
+struct GELU {
+    template <typename T> static T twiceU(T x) {
+        return T(2 * 0.7978845608028654) * (x + T(0.044715) * x * x * x);
+    }
+    template <typename T> T operator()(T x) const { return x * Sigmoid()(twiceU(x)); }
+};
+
+// ---------------------------------------------------------------------------
+// Sigmoid kernels: values[k] = sigmoid(values[k])
+// ---------------------------------------------------------------------------
+
+template <typename T>
+inline void sigmoidExact(size_t n, T* values) {
+    for (size_t k = 0; k < n; ++k) {
+        values[k] = T(1) / (T(1) + std::exp(-values[k]));
+    }
+}
+
+template <typename T>
+inline void sigmoidFast(size_t n, T* values) {
+    for (size_t k = 0; k < n; ++k) {
+        values[k] = T(1) / (T(1) + expFast(-values[k]));
+    }
+}
+
+#ifdef NN_GEMM_X86
+
+// expFast on four doubles
+__attribute__((target("avx2,fma")))
+inline __m256d expAvx2(__m256d x) {
+    x = _mm256_max_pd(_mm256_min_pd(x, _mm256_set1_pd(708.0)), _mm256_set1_pd(-708.0));
+    const __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(LOG2E)),
+                                      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_HI), x);
+    r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_LO), r);
+    __m256d p = _mm256_set1_pd(1.0 / 720);
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 120));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 24));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 6));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(0.5));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+    const __m256i ki = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+    const __m256i bits = _mm256_slli_epi64(_mm256_add_epi64(ki, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+}
+
+// expFast on eight floats
+__attribute__((target("avx2,fma")))
+inline __m256 expAvx2(__m256 x) {
+    x = _mm256_max_ps(_mm256_min_ps(x, _mm256_set1_ps(87.0f)), _mm256_set1_ps(-87.0f));
+    const __m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(float(LOG2E))),
+                                     _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(float(LN2_HI)), x);
+    r = _mm256_fnmadd_ps(k, _mm256_set1_ps(float(LN2_LO)), r);
+    __m256 p = _mm256_set1_ps(1.0f / 720);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 120));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 24));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 6));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(0.5f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f));
+    const __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+}
+
+__attribute__((target("avx2,fma")))
+inline void sigmoidAvx2(size_t n, double* values) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d zero = _mm256_setzero_pd();
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        const __m256d e = expAvx2(_mm256_sub_pd(zero, _mm256_loadu_pd(values + k)));
+        _mm256_storeu_pd(values + k, _mm256_div_pd(one, _mm256_add_pd(one, e)));
+    }
+    sigmoidFast(n - k, values + k);
+}
+
+__attribute__((target("avx2,fma")))
+inline void sigmoidAvx2(size_t n, float* values) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8) {
+        const __m256 e = expAvx2(_mm256_sub_ps(zero, _mm256_loadu_ps(values + k)));
+        _mm256_storeu_ps(values + k, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+    }
+    sigmoidFast(n - k, values + k);
+}
+
+#endif /* NN_GEMM_X86 */
+
+// Sigmoid kernel for the active mode and ISA
+template <typename T>
+inline void (*sigmoidKernel())(size_t, T*) {
+    if (!fastExpEnabled()) return &sigmoidExact<T>;
+#ifdef NN_GEMM_X86
+    if (kernels::activeIsa() >= kernels::Isa::AVX2) {
+        return static_cast<void (*)(size_t, T*)>(&sigmoidAvx2);
+    }
+#endif
+    return &sigmoidFast<T>;
+}
+
+// ---------------------------------------------------------------------------
+// Layer kernels
+// ---------------------------------------------------------------------------
+
+// Elementwise functions run over blocks of this many values, small enough
+// for a stack copy of the input (GELU) and large enough to amortise the
+// kernel call
+constexpr size_t BLOCK = 256;
+
+// out = f(z) for a rows x cols layer, with one sample per column. out may
+// be z itself.
+template <typename T>
+inline void forward(Function f, const T* z, T* out, size_t rows, size_t cols) {
+    const size_t n = rows * cols;
+    if (f == Function::Softmax) {
+        // Each column is one sample's distribution
+        for (size_t c = 0; c < cols; ++c) {
+            T peak = z[c];
+            for (size_t r = 1; r < rows; ++r) {
+                peak = std::max(peak, z[r * cols + c]);
+            }
+            T sum = T(0);
+            for (size_t r = 0; r < rows; ++r) {
+                out[r * cols + c] = activation::exp(z[r * cols + c] - peak);
+                sum += out[r * cols + c];
+            }
+            const T inv = T(1) / sum;
+            for (size_t r = 0; r < rows; ++r) {
+                out[r * cols + c] *= inv;
+            }
+        }
+        return;
+    }
+
+    const auto sigmoid = sigmoidKernel<T>();
+    forEachRange(n, [&](size_t lo, size_t hi) {
+        for (size_t begin = lo; begin < hi; begin += BLOCK) {
+            const size_t m = std::min(BLOCK, hi - begin);
+            const T* x = z + begin;
+            T* y = out + begin;
+            switch (f) {
+                case Function::Sigmoid:
+                    if (y != x) std::copy(x, x + m, y);
+                    sigmoid(m, y);
+                    break;
+                case Function::Tanh:
+                    // tanh(x) = 2 sigmoid(2x) - 1
+                    for (size_t k = 0; k < m; ++k) y[k] = T(2) * x[k];
+                    sigmoid(m, y);
+                    for (size_t k = 0; k < m; ++k) y[k] = T(2) * y[k] - T(1);
+                    break;
+                case Function::ReLU:
+                    for (size_t k = 0; k < m; ++k) y[k] = std::max(x[k], T(0));
+                    break;
+                case Function::LeakyReLU:
+                    for (size_t k = 0; k < m; ++k) y[k] = x[k] > T(0) ? x[k] : T(LEAKY_SLOPE) * x[k];
+                    break;
+                case Function::GELU: {
+                    T input[BLOCK];
+                    std::copy(x, x + m, input);
+                    for (size_t k = 0; k < m; ++k) y[k] = GELU::twiceU(input[k]);
+                    sigmoid(m, y);
+                    for (size_t k = 0; k < m; ++k) y[k] *= input[k];
+                    break;
+                }
+                case Function::Softmax:
+                    break;
+            }
+        }
+    });
+}
+
+// delta *= f'(z) for a rows x cols layer, where a = f(z) is the cached
+// forward output. z is only read for GELU and may be null otherwise.
+template <typename T>
+inline void backward(Function f, const T* a, const T* z, T* delta, size_t rows, size_t cols) {
+    const size_t n = rows * cols;
+    if (f == Function::Softmax) {
+        // Jacobian-vector product: delta_r = a_r (delta_r - sum_j a_j delta_j)
+        for (size_t c = 0; c < cols; ++c) {
+            T dot = T(0);
+            for (size_t r = 0; r < rows; ++r) {
+                dot += a[r * cols + c] * delta[r * cols + c];
+            }
+            for (size_t r = 0; r < rows; ++r) {
+                delta[r * cols + c] = a[r * cols + c] * (delta[r * cols + c] - dot);
+            }
+        }
+        return;
+    }
+    if (f == Function::GELU && z == nullptr) {
+        throw std::invalid_argument("GELU backward needs the layer input");
+    }
+
+    const auto sigmoid = sigmoidKernel<T>();
+    forEachRange(n, [&](size_t lo, size_t hi) {
+        for (size_t begin = lo; begin < hi; begin += BLOCK) {
+            const size_t m = std::min(BLOCK, hi - begin);
+            const T* y = a + begin;
+            T* d = delta + begin;
+            switch (f) {
+                case Function::Sigmoid:
+                    for (size_t k = 0; k < m; ++k) d[k] *= y[k] * (T(1) - y[k]);
+                    break;
+                case Function::Tanh:
+                    for (size_t k = 0; k < m; ++k) d[k] *= T(1) - y[k] * y[k];
+                    break;
+                case Function::ReLU:
+                    for (size_t k = 0; k < m; ++k) d[k] = y[k] > T(0) ? d[k] : T(0);
+                    break;
+                case Function::LeakyReLU:
+                    for (size_t k = 0; k < m; ++k) d[k] *= y[k] > T(0) ? T(1) : T(LEAKY_SLOPE);
+                    break;
+                case Function::GELU: {
+                    // d/dx x s(2u) = s + x s (1 - s) 2u', with s = sigmoid(2u)
+                    const T* x = z + begin;
+                    T s[BLOCK];
+                    for (size_t k = 0; k < m; ++k) s[k] = GELU::twiceU(x[k]);
+                    sigmoid(m, s);
+                    for (size_t k = 0; k < m; ++k) {
+                        const T du = T(2 * 0.7978845608028654) * (T(1) + T(3 * 0.044715) * x[k] * x[k]);
+                        d[k] *= s[k] + x[k] * s[k] * (T(1) - s[k]) * du;
+                    }
+                    break;
+                }
+                case Function::Softmax:
+                    break;
+            }
+        }
+    });
+}
+
+} // namespace activation
+
+using Activation = activation::Function;
+
+#endif /* activation_hpp */
@@ -0,0 +1,38 @@
+//
+//  aligned_allocator.hpp
+//  neural-network
+//
+
+#ifndef aligned_allocator_hpp
+#define aligned_allocator_hpp
+
+#include <new>
+#include <cstddef>
+
+// Cache-line aligned allocator so every Matrix buffer starts on a 64 byte
+// boundary, which keeps rows SIMD friendly and avoids split loads.
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() noexcept = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+    void deallocate(T* p, size_t) noexcept {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+#endif /* aligned_allocator_hpp */
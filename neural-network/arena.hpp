@@ -0,0 +1,158 @@
+//
+//  arena.hpp
+//  neural-network
+//
+
+#ifndef arena_hpp
+#define arena_hpp
+
+#include "matrix.hpp"
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+
+// Bump allocator for short-lived scratch (activations, deltas, gradients).
+// Allocation advances a pointer and reset() rewinds it, so memory handed out
+// during a training step is released all at once, in O(1), at the end of it.
+//
+// When a step needs more than the current block holds, the arena chains on
+// another block; the next reset() then replaces the chain with a single
+// block big enough for the peak seen so far. After the first step or two
+// the arena therefore never touches the heap again. peakBytes() reports the
+// high-water mark so production models can reserve() the right size up
+// front.
+//
+// Nothing is constructed or destroyed: only trivially destructible types
+// may be allocated here.
+class Arena {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    explicit Arena(size_t initialBytes = 0) {
+        if (initialBytes > 0) {
+            addBlock(initialBytes);
+        }
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    Arena(Arena&& other) noexcept
+    : blocks(std::move(other.blocks)), current(other.current), offset(other.offset),
+    used(other.used), peak(other.peak), grows(other.grows) {
+        other.blocks.clear();
+        other.current = other.offset = other.used = 0;
+    }
+
+    ~Arena() {
+        release();
+    }
+
+    // Uninitialised storage for n values of T, aligned to ALIGNMENT
+    template <typename T>
+    T* allocate(size_t n) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena memory is never destroyed");
+        const size_t bytes = roundUp(n * sizeof(T));
+        while (blocks.empty() || offset + bytes > blocks[current].size) {
+            if (!blocks.empty() && current + 1 < blocks.size()) {
+                ++current;
+                offset = 0;
+                continue;
+            }
+            addBlock(std::max(bytes, blocks.empty() ? bytes : blocks.back().size * 2));
+        }
+        std::byte* p = blocks[current].data + offset;
+        offset += bytes;
+        used += bytes;
+        peak = std::max(peak, used);
+        return reinterpret_cast<T*>(p);
+    }
+
+    // Uninitialised rows x cols row-major matrix
+    template <typename T>
+    StridedView<T> matrix(size_t rows, size_t cols) {
+        return StridedView<T>(allocate<T>(rows * cols), rows, cols, cols, 1);
+    }
+
+    // Release everything handed out since the last reset. O(1) unless the
+    // last cycle overflowed the first block, in which case the blocks are
+    // merged into one sized for the peak.
+    void reset() {
+        if (blocks.size() > 1) {
+            release();
+            addBlock(peak);
+        }
+        current = 0;
+        offset = 0;
+        used = 0;
+    }
+
+    // Resets the arena when it goes out of scope, so scratch is released
+    // even if a step throws
+    class Scope {
+    public:
+        explicit Scope(Arena& arena) : arena(arena) {}
+        ~Scope() { arena.reset(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        Arena& arena;
+    };
+
+    // Make sure at least `bytes` fit in a single block. Only takes effect
+    // between steps, when nothing is allocated.
+    void reserve(size_t bytes) {
+        if (used != 0 || (blocks.size() == 1 && blocks[0].size >= bytes)) return;
+        release();
+        addBlock(bytes);
+    }
+
+    // Statistics
+    size_t bytesUsed() const { return used; }
+    size_t peakBytes() const { return peak; }
+    size_t growCount() const { return grows; }
+    size_t capacity() const {
+        size_t total = 0;
+        for (const Block& block : blocks) total += block.size;
+        return total;
+    }
+
+private:
+    struct Block {
+        std::byte* data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t offset = 0;
+    size_t used = 0;
+    size_t peak = 0;
+    size_t grows = 0;
+
+    static size_t roundUp(size_t bytes) {
+        return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    void addBlock(size_t bytes) {
+        bytes = roundUp(std::max<size_t>(bytes, ALIGNMENT));
+        std::byte* data = static_cast<std::byte*>(::operator new(bytes, std::align_val_t(ALIGNMENT)));
+        blocks.push_back(Block{data, bytes});
+        current = blocks.size() - 1;
+        offset = 0;
+        ++grows;
+    }
+
+    void release() {
+        for (const Block& block : blocks) {
+            ::operator delete(block.data, std::align_val_t(ALIGNMENT));
+        }
+        blocks.clear();
+        current = 0;
+        offset = 0;
+    }
+};
+
+#endif /* arena_hpp */
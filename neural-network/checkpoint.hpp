@@ -0,0 +1,514 @@
+//
+//  checkpoint.hpp
+//  neural-network
+//
+//  Training checkpoints. A TrainingState is everything needed to resume a
+//  run exactly: the epoch count, the error history, the learning rate, the
+//  optimizer and schedule with their step count, the position of the
+//  network's shuffling stream, and every parameter and optimizer-state
+//  buffer as doubles.
+//
+//  A Checkpointer appends states to a log file from a background thread.
+//  submit() only takes ownership of a snapshot the network has already
+//  copied out, so the training loop never waits on encoding or disk; if the
+//  writer is still busy, a newer snapshot replaces the one waiting behind
+//  it. Each record stores every buffer either in full or as a delta against
+//  the previous record, whichever is smaller. A delta XORs each value's
+//  bits with its previous bits and drops the leading zero bytes, which
+//  removes the sign, exponent and high mantissa bits that small updates
+//  leave unchanged. Every `fullEvery`-th record is written in full.
+//
+//  Records are written field by field in the native byte order, with an
+//  endianness tag in each header (as in model_file.hpp) so that a reader
+//  with the other byte order rejects the log instead of misreading it.
+//
+//  latest() replays the log and returns the last state whose record is
+//  complete and passes its checksum. A damaged record, and the deltas that
+//  build on it, are skipped up to the next full record, so a crash
+//  mid-write loses at most the record being written, and damage in the
+//  middle of the log at most the records up to the next full one. A write
+//  that fails is cut back off the file, so later records follow straight
+//  on from the last good one.
+//
+
+#ifndef checkpoint_hpp
+#define checkpoint_hpp
+
+#include "optimizer.hpp"
+#include "random.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <filesystem>
+#include <system_error>
+#include <stdexcept>
+#include <type_traits>
+
+struct TrainingState {
+    std::vector<size_t> architecture;
+    int totalEpochs = 0;
+    std::pair<int, double> cachedError{0, 0.0};
+    std::pair<int, double> prevError{0, 0.0};
+    double trainingError = 0.0;
+    double learningRate = 0.0;
+    Optimizer optimizer;
+    Schedule schedule;
+    long optimizerSteps = 0;
+    // The network's shuffling and sampling stream
+    Rng::State generator;
+    // Parameters and optimizer state, in an order defined by the engine
+    std::vector<std::vector<double>> buffers;
+};
+
+namespace checkpoint {
+
+constexpr char MAGIC[4] = {'N', 'N', 'C', 'K'};
+constexpr uint32_t VERSION = 2;
+constexpr uint32_t ENDIAN_TAG = 0x01020304;
+// ENDIAN_TAG as read back on a machine with the other byte order
+constexpr uint32_t SWAPPED_ENDIAN_TAG = 0x04030201;
+
+enum Encoding : uint8_t { Raw = 0, XorDelta = 1 };
+
+struct RecordHeader {
+    char magic[4];
+    uint32_t endianTag;
+    uint32_t version;
+    uint32_t full;              // 1 when no buffer depends on the previous record
+    uint64_t payloadSize;
+    uint64_t checksum;
+};
+static_assert(sizeof(RecordHeader) == 32, "Record header layout must not depend on the compiler");
+
+inline uint64_t checksum(const unsigned char* data, size_t n) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t k = 0; k < n; ++k) {
+        hash = (hash ^ data[k]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline uint64_t bitsOf(double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+inline double fromBits(uint64_t bits) {
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// Payload writer, in native byte order
+class Writer {
+public:
+    std::vector<unsigned char> bytes;
+
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only plain values are written directly");
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(&value);
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+    void putBytes(const unsigned char* p, size_t n) {
+        bytes.insert(bytes.end(), p, p + n);
+    }
+};
+
+class Reader {
+private:
+    const unsigned char* p;
+    const unsigned char* end;
+
+public:
+    Reader(const unsigned char* data, size_t n) : p(data), end(data + n) {}
+
+    template <typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+    const unsigned char* take(size_t n) {
+        if (static_cast<size_t>(end - p) < n) {
+            throw std::runtime_error("Checkpoint record is truncated");
+        }
+        const unsigned char* at = p;
+        p += n;
+        return at;
+    }
+};
+
+// Each value's bits XOR the previous bits, as a count of leading zero
+// bytes followed by the remaining low-order bytes
+inline std::vector<unsigned char> encodeDelta(const std::vector<double>& values, const std::vector<double>& previous) {
+    std::vector<unsigned char> out;
+    out.reserve(values.size() * 3);
+    for (size_t k = 0; k < values.size(); ++k) {
+        const uint64_t x = bitsOf(values[k]) ^ bitsOf(previous[k]);
+        unsigned char length = 8;
+        while (length > 0 && ((x >> (8 * (length - 1))) & 0xff) == 0) {
+            --length;
+        }
+        out.push_back(static_cast<unsigned char>(8 - length));
+        for (unsigned char b = 0; b < length; ++b) {
+            out.push_back(static_cast<unsigned char>(x >> (8 * b)));
+        }
+    }
+    return out;
+}
+
+inline void decodeDelta(Reader& in, std::vector<double>& values) {
+    for (double& v : values) {
+        const unsigned char zeros = in.get<unsigned char>();
+        if (zeros > 8) {
+            throw std::runtime_error("Checkpoint delta is corrupt");
+        }
+        const unsigned char* low = in.take(8 - zeros);
+        uint64_t x = 0;
+        for (unsigned char b = 0; b < 8 - zeros; ++b) {
+            x |= static_cast<uint64_t>(low[b]) << (8 * b);
+        }
+        v = fromBits(bitsOf(v) ^ x);
+    }
+}
+
+// Optimizer and schedule settings, field by field so no padding reaches
+// the file
+inline void putOptimizer(Writer& out, const Optimizer& opt) {
+    out.put<uint32_t>(static_cast<uint32_t>(opt.method));
+    out.put<double>(opt.momentum);
+    out.put<double>(opt.decay);
+    out.put<double>(opt.beta1);
+    out.put<double>(opt.beta2);
+    out.put<double>(opt.epsilon);
+    out.put<double>(opt.weightDecay);
+}
+
+inline Optimizer getOptimizer(Reader& in) {
+    Optimizer opt;
+    const uint32_t method = in.get<uint32_t>();
+    if (method > static_cast<uint32_t>(optim::Method::AdamW)) {
+        throw std::runtime_error("Checkpoint has an unknown optimizer");
+    }
+    opt.method = static_cast<optim::Method>(method);
+    opt.momentum = in.get<double>();
+    opt.decay = in.get<double>();
+    opt.beta1 = in.get<double>();
+    opt.beta2 = in.get<double>();
+    opt.epsilon = in.get<double>();
+    opt.weightDecay = in.get<double>();
+    return opt;
+}
+
+inline void putSchedule(Writer& out, const Schedule& schedule) {
+    out.put<uint32_t>(static_cast<uint32_t>(schedule.type));
+    out.put<double>(schedule.gamma);
+    out.put<int32_t>(schedule.period);
+    out.put<double>(schedule.minFactor);
+    out.put<int32_t>(schedule.warmup);
+}
+
+inline Schedule getSchedule(Reader& in) {
+    Schedule schedule;
+    const uint32_t type = in.get<uint32_t>();
+    if (type > static_cast<uint32_t>(Schedule::Type::Cosine)) {
+        throw std::runtime_error("Checkpoint has an unknown learning-rate schedule");
+    }
+    schedule.type = static_cast<Schedule::Type>(type);
+    schedule.gamma = in.get<double>();
+    schedule.period = in.get<int32_t>();
+    schedule.minFactor = in.get<double>();
+    schedule.warmup = in.get<int32_t>();
+    return schedule;
+}
+
+// Payload for `state`, with deltas against `previous` when given and
+// smaller. Sets `full` when nothing refers to previous.
+inline std::vector<unsigned char> encode(const TrainingState& state, const TrainingState* previous, bool& full) {
+    Writer out;
+    out.put<int32_t>(state.totalEpochs);
+    out.put<int32_t>(state.cachedError.first);
+    out.put<double>(state.cachedError.second);
+    out.put<int32_t>(state.prevError.first);
+    out.put<double>(state.prevError.second);
+    out.put<double>(state.trainingError);
+    out.put<double>(state.learningRate);
+    putOptimizer(out, state.optimizer);
+    putSchedule(out, state.schedule);
+    out.put<int64_t>(state.optimizerSteps);
+    out.put<uint64_t>(state.generator.key);
+    out.put<uint64_t>(state.generator.stream);
+    out.put<uint64_t>(state.generator.position);
+    out.put<uint32_t>(static_cast<uint32_t>(state.architecture.size()));
+    for (size_t size : state.architecture) {
+        out.put<uint64_t>(size);
+    }
+
+    full = true;
+    out.put<uint32_t>(static_cast<uint32_t>(state.buffers.size()));
+    for (size_t i = 0; i < state.buffers.size(); ++i) {
+        const std::vector<double>& values = state.buffers[i];
+        out.put<uint64_t>(values.size());
+        const size_t rawBytes = values.size() * sizeof(double);
+        if (previous && i < previous->buffers.size() && previous->buffers[i].size() == values.size()) {
+            const std::vector<unsigned char> delta = encodeDelta(values, previous->buffers[i]);
+            if (delta.size() < rawBytes) {
+                out.put<uint8_t>(XorDelta);
+                out.put<uint64_t>(delta.size());
+                out.putBytes(delta.data(), delta.size());
+                full = false;
+                continue;
+            }
+        }
+        out.put<uint8_t>(Raw);
+        out.put<uint64_t>(rawBytes);
+        out.putBytes(reinterpret_cast<const unsigned char*>(values.data()), rawBytes);
+    }
+    return std::move(out.bytes);
+}
+
+// Applies a payload on top of `state`, the result of the records before it
+inline void decode(const unsigned char* data, size_t n, TrainingState& state) {
+    Reader in(data, n);
+    state.totalEpochs = in.get<int32_t>();
+    state.cachedError.first = in.get<int32_t>();
+    state.cachedError.second = in.get<double>();
+    state.prevError.first = in.get<int32_t>();
+    state.prevError.second = in.get<double>();
+    state.trainingError = in.get<double>();
+    state.learningRate = in.get<double>();
+    state.optimizer = getOptimizer(in);
+    state.schedule = getSchedule(in);
+    state.optimizerSteps = static_cast<long>(in.get<int64_t>());
+    state.generator.key = in.get<uint64_t>();
+    state.generator.stream = in.get<uint64_t>();
+    state.generator.position = in.get<uint64_t>();
+    state.architecture.resize(in.get<uint32_t>());
+    for (size_t& size : state.architecture) {
+        size = static_cast<size_t>(in.get<uint64_t>());
+    }
+
+    const size_t count = in.get<uint32_t>();
+    std::vector<std::vector<double>> buffers(count);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t values = static_cast<size_t>(in.get<uint64_t>());
+        const uint8_t encoding = in.get<uint8_t>();
+        const size_t bytes = static_cast<size_t>(in.get<uint64_t>());
+        Reader block(in.take(bytes), bytes);
+        if (encoding == Raw) {
+            buffers[i].resize(values);
+            std::memcpy(buffers[i].data(), block.take(values * sizeof(double)), values * sizeof(double));
+        } else if (encoding == XorDelta && i < state.buffers.size() && state.buffers[i].size() == values) {
+            buffers[i] = std::move(state.buffers[i]);
+            decodeDelta(block, buffers[i]);
+        } else {
+            throw std::runtime_error("Checkpoint delta has no matching previous buffer");
+        }
+    }
+    state.buffers = std::move(buffers);
+}
+
+} // namespace checkpoint
+
+// Appends training states to a checkpoint log from a background thread
+class Checkpointer {
+private:
+    std::string path;
+    int fullEvery;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::optional<TrainingState> pending;
+    bool writing;
+    bool stopping;
+    std::string error;
+    // Writer-thread state: the last state written, for deltas
+    std::optional<TrainingState> previous;
+    size_t records;
+    size_t bytes;
+    // Size of the log up to the end of its last good record
+    uint64_t goodSize;
+
+    void write(const TrainingState& state) {
+        const bool forceFull = fullEvery <= 1 || records % static_cast<size_t>(fullEvery) == 0;
+        bool full = true;
+        const std::vector<unsigned char> payload =
+            checkpoint::encode(state, forceFull || !previous ? nullptr : &*previous, full);
+
+        checkpoint::RecordHeader header;
+        std::memcpy(header.magic, checkpoint::MAGIC, sizeof(header.magic));
+        header.endianTag = checkpoint::ENDIAN_TAG;
+        header.version = checkpoint::VERSION;
+        header.full = full ? 1 : 0;
+        header.payloadSize = payload.size();
+        header.checksum = checkpoint::checksum(payload.data(), payload.size());
+
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+        file.flush();
+        const bool written = static_cast<bool>(file);
+        file.close();
+        if (!written) {
+            // Drop whatever part of the record made it, so the next one
+            // isn't appended after torn bytes
+            std::error_code ignored;
+            std::filesystem::resize_file(path, goodSize, ignored);
+            throw std::runtime_error("Could not write checkpoint " + path);
+        }
+        ++records;
+        bytes += sizeof(header) + payload.size();
+        goodSize += sizeof(header) + payload.size();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [&] { return pending.has_value() || stopping; });
+            if (!pending) return;
+            TrainingState state = std::move(*pending);
+            pending.reset();
+            writing = true;
+            lock.unlock();
+            try {
+                write(state);
+                previous = std::move(state);
+            } catch (const std::exception& e) {
+                lock.lock();
+                error = e.what();
+                lock.unlock();
+            }
+            lock.lock();
+            writing = false;
+            changed.notify_all();
+        }
+    }
+
+public:
+    // Appends to `path`, writing every fullEvery-th record without deltas
+    // so a damaged record can only spoil the records up to the next full
+    // one (see latest())
+    explicit Checkpointer(const std::string& path, int fullEvery = 10)
+    : path(path), fullEvery(fullEvery), writing(false), stopping(false), records(0), bytes(0) {
+        std::error_code missing;
+        const uintmax_t size = std::filesystem::file_size(path, missing);
+        goodSize = missing ? 0 : static_cast<uint64_t>(size);
+        writer = std::thread([this] { run(); });
+    }
+
+    // Writes whatever is still pending
+    ~Checkpointer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        writer.join();
+    }
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    // Queues a snapshot and returns at once. A snapshot still waiting from
+    // an earlier call is replaced.
+    void submit(TrainingState state) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = std::move(state);
+        }
+        changed.notify_all();
+    }
+
+    // Waits until every submitted snapshot is on disk; throws if a write
+    // failed
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return !pending && !writing; });
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+    }
+
+    // Records and bytes written so far (call after flush())
+    size_t recordCount() const {
+        return records;
+    }
+    size_t bytesWritten() const {
+        return bytes;
+    }
+
+    // The last complete state in the log at `path`
+    static TrainingState latest(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Could not open checkpoint " + path);
+        }
+        const std::vector<unsigned char> log((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        // A sound record at `offset`, or null
+        auto recordAt = [&](size_t offset, checkpoint::RecordHeader& header) -> const unsigned char* {
+            if (log.size() - offset < sizeof(header)) return nullptr;
+            std::memcpy(&header, log.data() + offset, sizeof(header));
+            const unsigned char* payload = log.data() + offset + sizeof(header);
+            if (std::memcmp(header.magic, checkpoint::MAGIC, sizeof(header.magic)) != 0
+                || header.payloadSize > log.size() - offset - sizeof(header)
+                || checkpoint::checksum(payload, header.payloadSize) != header.checksum) {
+                return nullptr;
+            }
+            if (header.endianTag == checkpoint::SWAPPED_ENDIAN_TAG) {
+                throw std::runtime_error(path + " was written on a machine with a different byte order");
+            }
+            if (header.endianTag != checkpoint::ENDIAN_TAG) {
+                return nullptr;
+            }
+            if (header.version != checkpoint::VERSION) {
+                throw std::runtime_error(path + " has unsupported checkpoint format version " + std::to_string(header.version));
+            }
+            return payload;
+        };
+
+        TrainingState state;
+        bool found = false;
+        // Set after a damaged record, until the next full record
+        bool skipping = false;
+        size_t offset = 0;
+        while (log.size() - offset >= sizeof(checkpoint::RecordHeader)) {
+            checkpoint::RecordHeader header;
+            const unsigned char* payload = recordAt(offset, header);
+            if (!payload || (skipping && header.full != 1)) {
+                // Look for the next record byte by byte: the damaged
+                // record's length can't be trusted
+                skipping = true;
+                offset += payload ? sizeof(header) + header.payloadSize : 1;
+                continue;
+            }
+            TrainingState next = state;
+            try {
+                checkpoint::decode(payload, header.payloadSize, next);
+                state = std::move(next);
+                found = true;
+                skipping = false;
+            } catch (const std::exception&) {
+                skipping = true;
+            }
+            offset += sizeof(header) + header.payloadSize;
+        }
+        if (!found) {
+            throw std::runtime_error("No complete checkpoint in " + path);
+        }
+        return state;
+    }
+};
+
+#endif /* checkpoint_hpp */
@@ -0,0 +1,162 @@
+//
+//  dataset.hpp
+//  neural-network
+//
+//  Training data stored contiguously. A Dataset keeps every sample's
+//  features in one row-major block (sample i at i * inputSize) and its
+//  labels in another, so reading a sample is an offset rather than a
+//  pointer chase, and handing data to a network or the visualiser copies
+//  nothing. DatasetView is the non-owning form the networks train from; a
+//  mini-batch of consecutive samples is a view of the same memory.
+//
+//  Data too large to hold at once comes from a BatchSource instead, which
+//  hands out one mini-batch at a time (see dataset_file.hpp).
+//
+
+#ifndef dataset_hpp
+#define dataset_hpp
+
+#include "aligned_allocator.hpp"
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+
+// Samples [0, size()) of features and labels owned elsewhere
+class DatasetView {
+private:
+    const double* features = nullptr;
+    const double* labels = nullptr;
+    size_t count = 0;
+    size_t inputWidth = 0;
+    size_t outputWidth = 0;
+
+public:
+    DatasetView() = default;
+    DatasetView(const double* features, const double* labels, size_t count, size_t inputSize, size_t outputSize)
+    : features(features), labels(labels), count(count), inputWidth(inputSize), outputWidth(outputSize) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t inputSize() const { return inputWidth; }
+    size_t outputSize() const { return outputWidth; }
+
+    std::span<const double> input(size_t i) const {
+        return std::span<const double>(features + i * inputWidth, inputWidth);
+    }
+    std::span<const double> target(size_t i) const {
+        return std::span<const double>(labels + i * outputWidth, outputWidth);
+    }
+
+    // Every sample's features (resp. labels), one sample after another
+    std::span<const double> inputs() const {
+        return std::span<const double>(features, count * inputWidth);
+    }
+    std::span<const double> targets() const {
+        return std::span<const double>(labels, count * outputWidth);
+    }
+
+    // Samples [first, first + n), clamped to the end
+    DatasetView batch(size_t first, size_t n) const {
+        first = std::min(first, count);
+        n = std::min(n, count - first);
+        return DatasetView(features + first * inputWidth, labels + first * outputWidth, n, inputWidth, outputWidth);
+    }
+};
+
+class Dataset {
+private:
+    std::vector<double, AlignedAllocator<double>> features;
+    std::vector<double, AlignedAllocator<double>> labels;
+    size_t count = 0;
+    size_t inputWidth = 0;
+    size_t outputWidth = 0;
+
+public:
+    Dataset() = default;
+    // `count` zeroed samples, to be filled in through input(i) and target(i)
+    Dataset(size_t inputSize, size_t outputSize, size_t count = 0)
+    : features(count * inputSize), labels(count * outputSize), count(count),
+    inputWidth(inputSize), outputWidth(outputSize) {}
+
+    // Copies ragged per-sample vectors, which must all have the same sizes
+    Dataset(const std::vector<std::vector<double>>& inputs, const std::vector<std::vector<double>>& targets)
+    : Dataset(inputs.empty() ? 0 : inputs[0].size(), targets.empty() ? 0 : targets[0].size()) {
+        if (inputs.size() != targets.size()) {
+            throw std::invalid_argument("Number of inputs must match number of targets");
+        }
+        reserve(inputs.size());
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            add(inputs[i], targets[i]);
+        }
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t inputSize() const { return inputWidth; }
+    size_t outputSize() const { return outputWidth; }
+
+    std::span<double> input(size_t i) {
+        return std::span<double>(features.data() + i * inputWidth, inputWidth);
+    }
+    std::span<double> target(size_t i) {
+        return std::span<double>(labels.data() + i * outputWidth, outputWidth);
+    }
+    std::span<const double> input(size_t i) const {
+        return view().input(i);
+    }
+    std::span<const double> target(size_t i) const {
+        return view().target(i);
+    }
+
+    DatasetView view() const {
+        return DatasetView(features.data(), labels.data(), count, inputWidth, outputWidth);
+    }
+    operator DatasetView() const {
+        return view();
+    }
+    DatasetView batch(size_t first, size_t n) const {
+        return view().batch(first, n);
+    }
+
+    void add(std::span<const double> input, std::span<const double> target) {
+        if (input.size() != inputWidth || target.size() != outputWidth) {
+            throw std::invalid_argument("Sample size must match the data set");
+        }
+        features.insert(features.end(), input.begin(), input.end());
+        labels.insert(labels.end(), target.begin(), target.end());
+        ++count;
+    }
+
+    // Grows with zeroed samples or drops samples from the end
+    void resize(size_t n) {
+        features.resize(n * inputWidth);
+        labels.resize(n * outputWidth);
+        count = n;
+    }
+    void reserve(size_t n) {
+        features.reserve(n * inputWidth);
+        labels.reserve(n * outputWidth);
+    }
+    void clear() {
+        resize(0);
+    }
+};
+
+// Mini-batches streamed an epoch at a time, for data that is not all in
+// memory at once
+class BatchSource {
+public:
+    virtual ~BatchSource() = default;
+
+    virtual size_t inputSize() const = 0;
+    virtual size_t outputSize() const = 0;
+    // Starts the next epoch
+    virtual void rewind() = 0;
+    // The next mini-batch of the epoch, or an empty view once the epoch is
+    // done. The view stays valid until the next call.
+    virtual DatasetView next() = 0;
+};
+
+#endif /* dataset_hpp */
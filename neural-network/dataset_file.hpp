@@ -0,0 +1,579 @@
+//
+//  dataset_file.hpp
+//  neural-network
+//
+//  Binary data set format, built to be memory-mapped and streamed. A file
+//  is
+//
+//      Header
+//      padding to 64 bytes
+//      features: count x inputSize values, one sample after another
+//      padding to 64 bytes
+//      labels: count x outputSize values, the same way
+//      padding to 64 bytes
+//
+//  The two columns of the table, features and labels, are stored apart so
+//  that either one maps straight onto a DatasetView. Values are stored in
+//  the native byte order as the scalar type recorded in the header (see
+//  model_file.hpp, whose tags and checksum this format shares); float
+//  halves the file and the disk traffic at the cost of precision the
+//  inputs rarely have. Each column has its own checksum, covering its
+//  padding.
+//
+//  convertCsv() writes the format once from a CSV file, streaming it, so
+//  neither file has to fit in memory. open() maps a file read-only, and a
+//  Loader streams shuffled mini-batches out of the mapping for
+//  Network::train(BatchSource&):
+//
+//      dataset::convertCsv<float>("train.csv", "train.nnd", 784, 10);
+//      dataset::Loader loader(dataset::open("train.nnd"), 64);
+//      network.train(loader, epochs);
+//
+
+#ifndef dataset_file_hpp
+#define dataset_file_hpp
+
+#include "dataset.hpp"
+#include "model_file.hpp"
+#include "random.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <span>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dataset {
+
+using model::ScalarType;
+
+constexpr char MAGIC[8] = {'N', 'N', 'D', 'A', 'T', 'A', '\0', '\0'};
+constexpr uint32_t VERSION = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t endianTag;
+    uint32_t version;
+    uint32_t scalarType;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t inputSize;
+    uint64_t outputSize;
+    uint64_t fileSize;
+    uint64_t featureChecksum;
+    uint64_t labelChecksum;
+};
+static_assert(sizeof(Header) == 72, "Header layout must not depend on the compiler");
+
+// Byte offsets of both columns for a given shape and scalar type
+struct Layout {
+    uint64_t featureOffset = 0;
+    uint64_t labelOffset = 0;
+    uint64_t fileSize = 0;
+
+    Layout() = default;
+    Layout(uint64_t count, uint64_t inputSize, uint64_t outputSize, ScalarType type) {
+        const size_t scalar = model::scalarSize(type);
+        featureOffset = model::alignUp(sizeof(Header));
+        labelOffset = model::alignUp(featureOffset + count * inputSize * scalar);
+        fileSize = model::alignUp(labelOffset + count * outputSize * scalar);
+    }
+};
+
+// Writes a data set one sample at a time. Features go straight to the
+// file and labels to a side file appended on finish(), so the number of
+// samples needn't be known up front and nothing is held in memory.
+template <typename T>
+class Writer {
+private:
+    std::string path;
+    std::string labelPath;
+    std::ofstream features;
+    std::ofstream labels;
+    size_t inputWidth;
+    size_t outputWidth;
+    uint64_t count;
+    std::vector<T> scratch;
+
+    // FNV-1a over 8-byte words, as model::checksum, fed in pieces
+    struct Hash {
+        uint64_t value = 0xcbf29ce484222325ull;
+        unsigned char word[8];
+        size_t used = 0;
+
+        void add(const unsigned char* bytes, size_t n) {
+            for (size_t k = 0; k < n; ++k) {
+                word[used++] = bytes[k];
+                if (used == 8) {
+                    uint64_t w;
+                    std::memcpy(&w, word, sizeof(w));
+                    value = (value ^ w) * 0x100000001b3ull;
+                    used = 0;
+                }
+            }
+        }
+    };
+    Hash featureHash;
+    Hash labelHash;
+
+    void put(std::ofstream& file, Hash& hash, std::span<const double> values) {
+        scratch.assign(values.begin(), values.end());
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(scratch.data());
+        hash.add(bytes, scratch.size() * sizeof(T));
+        file.write(reinterpret_cast<const char*>(bytes), static_cast<std::streamsize>(scratch.size() * sizeof(T)));
+    }
+
+    // Zeros from `offset` up to `end`, which the checksum covers too
+    static void pad(std::ofstream& file, Hash& hash, uint64_t offset, uint64_t end) {
+        static const unsigned char zeros[model::ALIGNMENT] = {};
+        hash.add(zeros, end - offset);
+        file.write(reinterpret_cast<const char*>(zeros), static_cast<std::streamsize>(end - offset));
+    }
+
+public:
+    Writer(const std::string& path, size_t inputSize, size_t outputSize)
+    : path(path), labelPath(path + ".labels"), inputWidth(inputSize), outputWidth(outputSize), count(0) {
+        static_assert(std::is_same_v<T, double> || std::is_same_v<T, float>, "Data sets store double or float");
+        features.open(path, std::ios::binary | std::ios::trunc);
+        labels.open(labelPath, std::ios::binary | std::ios::trunc);
+        if (!features || !labels) {
+            throw std::runtime_error("Could not write data set file " + path);
+        }
+        // The header is written last, over these zeros
+        const std::vector<char> zeros(model::alignUp(sizeof(Header)), 0);
+        features.write(zeros.data(), static_cast<std::streamsize>(zeros.size()));
+    }
+    ~Writer() {
+        if (labels.is_open()) {
+            labels.close();
+            std::remove(labelPath.c_str());
+        }
+    }
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    void add(std::span<const double> input, std::span<const double> target) {
+        if (input.size() != inputWidth || target.size() != outputWidth) {
+            throw std::invalid_argument("Sample size must match the data set");
+        }
+        put(features, featureHash, input);
+        put(labels, labelHash, target);
+        ++count;
+    }
+
+    // Completes the file; returns the number of samples written
+    uint64_t finish() {
+        const ScalarType type = model::scalarTypeOf<T>();
+        const Layout layout(count, inputWidth, outputWidth, type);
+        const uint64_t featureEnd = layout.featureOffset + count * inputWidth * sizeof(T);
+        pad(features, featureHash, featureEnd, layout.labelOffset);
+
+        labels.close();
+        if (count * outputWidth > 0) {
+            std::ifstream side(labelPath, std::ios::binary);
+            features << side.rdbuf();
+        }
+        std::remove(labelPath.c_str());
+        const uint64_t labelEnd = layout.labelOffset + count * outputWidth * sizeof(T);
+        pad(features, labelHash, labelEnd, layout.fileSize);
+
+        Header header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.endianTag = model::ENDIAN_TAG;
+        header.version = VERSION;
+        header.scalarType = static_cast<uint32_t>(type);
+        header.reserved = 0;
+        header.count = count;
+        header.inputSize = inputWidth;
+        header.outputSize = outputWidth;
+        header.fileSize = layout.fileSize;
+        header.featureChecksum = featureHash.value;
+        header.labelChecksum = labelHash.value;
+        features.seekp(0);
+        features.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        features.close();
+        if (!features) {
+            throw std::runtime_error("Could not write data set file " + path);
+        }
+        return count;
+    }
+};
+
+// Writes `data` to `path`, storing values as T
+template <typename T = double>
+inline void write(const std::string& path, const DatasetView& data) {
+    Writer<T> writer(path, data.inputSize(), data.outputSize());
+    for (size_t i = 0; i < data.size(); ++i) {
+        writer.add(data.input(i), data.target(i));
+    }
+    writer.finish();
+}
+
+// Converts a CSV file with inputSize feature columns followed by
+// outputSize label columns per row, storing values as T. Blank lines are
+// skipped, as is the first line when it is a header. Returns the number
+// of samples.
+template <typename T = double>
+inline uint64_t convertCsv(const std::string& csvPath, const std::string& path,
+                           size_t inputSize, size_t outputSize, bool hasHeader = false) {
+    std::ifstream csv(csvPath);
+    if (!csv) {
+        throw std::runtime_error("Could not open CSV file " + csvPath);
+    }
+    Writer<T> writer(path, inputSize, outputSize);
+    std::vector<double> row;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(csv, line); ++lineNumber) {
+        if (lineNumber == 1 && hasHeader) continue;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        row.clear();
+        const char* p = line.c_str();
+        while (true) {
+            char* end;
+            const double value = std::strtod(p, &end);
+            if (end == p) {
+                throw std::runtime_error(csvPath + ":" + std::to_string(lineNumber) + ": expected a number");
+            }
+            row.push_back(value);
+            p = end;
+            while (*p == ' ' || *p == '\t' || *p == '\r') ++p;
+            if (*p == '\0') break;
+            if (*p != ',') {
+                throw std::runtime_error(csvPath + ":" + std::to_string(lineNumber) + ": expected a comma");
+            }
+            ++p;
+        }
+        if (row.size() != inputSize + outputSize) {
+            throw std::runtime_error(csvPath + ":" + std::to_string(lineNumber) + ": expected "
+                                     + std::to_string(inputSize + outputSize) + " columns");
+        }
+        writer.add(std::span<const double>(row.data(), inputSize),
+                   std::span<const double>(row.data() + inputSize, outputSize));
+    }
+    return writer.finish();
+}
+
+// A read-only, shared mapping of a whole file
+class Mapping {
+private:
+    void* base;
+    size_t length;
+
+public:
+    explicit Mapping(const std::string& path) : base(nullptr), length(0) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open data set file " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+            ::close(fd);
+            throw std::runtime_error("Data set file " + path + " is too short");
+        }
+        length = static_cast<size_t>(info.st_size);
+        base = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error("Could not map data set file " + path);
+        }
+    }
+    ~Mapping() {
+        ::munmap(base, length);
+    }
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    const unsigned char* data() const { return static_cast<const unsigned char*>(base); }
+    size_t size() const { return length; }
+
+    // Hints about bytes [offset, offset + n): about to be read, or done with
+    // for now. Dropped pages are read back from the file if touched again.
+    void willNeed(uint64_t offset, uint64_t n) const { advise(offset, n, MADV_WILLNEED); }
+    void dontNeed(uint64_t offset, uint64_t n) const { advise(offset, n, MADV_DONTNEED); }
+    // Expected pattern of reads over the whole file
+    void expect(bool sequential) const {
+        ::madvise(base, length, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+
+private:
+    void advise(uint64_t offset, uint64_t n, int advice) const {
+        static const uint64_t page = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+        const uint64_t first = offset / page * page;
+        const uint64_t last = std::min<uint64_t>(offset + n, length);
+        if (last > first) {
+            ::madvise(static_cast<unsigned char*>(base) + first, last - first, advice);
+        }
+    }
+};
+
+// A validated, mapped data set file
+struct File {
+    std::shared_ptr<Mapping> mapping;
+    Header header;
+    Layout layout;
+
+    ScalarType scalarType() const {
+        return static_cast<ScalarType>(header.scalarType);
+    }
+    size_t size() const { return header.count; }
+    size_t inputSize() const { return header.inputSize; }
+    size_t outputSize() const { return header.outputSize; }
+
+    // Both columns, in the file's scalar type T
+    template <typename T>
+    const T* features() const {
+        return reinterpret_cast<const T*>(mapping->data() + layout.featureOffset);
+    }
+    template <typename T>
+    const T* labels() const {
+        return reinterpret_cast<const T*>(mapping->data() + layout.labelOffset);
+    }
+
+    // The whole file as a data set, read in place. Only files of doubles
+    // can be viewed; load() converts the others.
+    DatasetView view() const {
+        if (scalarType() != ScalarType::Float64) {
+            throw std::logic_error("Only a data set file of doubles can be viewed in place");
+        }
+        return DatasetView(features<double>(), labels<double>(), size(), inputSize(), outputSize());
+    }
+
+    // Copies the whole file into memory as doubles
+    Dataset load() const {
+        Dataset data(inputSize(), outputSize(), size());
+        if (size() == 0) return data;
+        if (scalarType() == ScalarType::Float64) {
+            std::copy_n(features<double>(), size() * inputSize(), data.input(0).data());
+            std::copy_n(labels<double>(), size() * outputSize(), data.target(0).data());
+        } else {
+            std::copy_n(features<float>(), size() * inputSize(), data.input(0).data());
+            std::copy_n(labels<float>(), size() * outputSize(), data.target(0).data());
+        }
+        return data;
+    }
+};
+
+// Maps and validates a data set file. Verifying the checksums reads the
+// whole file, which for a large set costs as much as an epoch; skip it to
+// start streaming straight away.
+inline File open(const std::string& path, bool verify = true) {
+    File file;
+    file.mapping = std::make_shared<Mapping>(path);
+    const unsigned char* bytes = file.mapping->data();
+    std::memcpy(&file.header, bytes, sizeof(Header));
+    const Header& header = file.header;
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(path + " is not a data set file");
+    }
+    if (header.endianTag != model::ENDIAN_TAG) {
+        throw std::runtime_error(path + " was written on a machine with a different byte order");
+    }
+    if (header.version != VERSION) {
+        throw std::runtime_error(path + " has unsupported data set format version " + std::to_string(header.version));
+    }
+    if (header.scalarType > static_cast<uint32_t>(ScalarType::Float32)) {
+        throw std::runtime_error(path + " has an unknown scalar type");
+    }
+    // The shape is untrusted: bound each column by the file size before
+    // Layout multiplies it out, so the products can't overflow
+    const uint64_t limit = header.fileSize;
+    const uint64_t scalar = model::scalarSize(file.scalarType());
+    if (header.fileSize != file.mapping->size() || header.inputSize == 0 || header.outputSize == 0
+        || header.inputSize > limit / scalar || header.count > limit / (header.inputSize * scalar)
+        || header.outputSize > limit / scalar || header.count > limit / (header.outputSize * scalar)) {
+        throw std::runtime_error(path + " is truncated or corrupt");
+    }
+    file.layout = Layout(header.count, header.inputSize, header.outputSize, file.scalarType());
+    if (file.layout.fileSize != header.fileSize) {
+        throw std::runtime_error(path + " is truncated or corrupt");
+    }
+    if (verify) {
+        const Layout& layout = file.layout;
+        if (model::checksum(bytes + layout.featureOffset, layout.labelOffset - layout.featureOffset) != header.featureChecksum
+            || model::checksum(bytes + layout.labelOffset, layout.fileSize - layout.labelOffset) != header.labelChecksum) {
+            throw std::runtime_error(path + " failed its checksum");
+        }
+    }
+    return file;
+}
+
+// Streams mini-batches out of a mapped file. Random access to single
+// samples would read the disk a page at a time, so shuffling works on
+// chunks of consecutive samples instead: each epoch visits the chunks in
+// a random order, `window` chunks at a time, and shuffles the samples of
+// the chunks in the window together. Those chunks are paged in ahead of
+// use and dropped once consumed, so memory use stays at about two windows
+// however large the file, and reads are long and sequential. The order
+// is a permutation of every sample each epoch, and is fixed by the seed.
+//
+// Batches are converted to doubles in buffers the Loader owns. A file of
+// doubles read in order needs no conversion, and its batches point into
+// the mapping.
+class Loader : public BatchSource {
+private:
+    File file;
+    size_t batchSize;
+    bool shuffle;
+    size_t chunkSize;
+    size_t window;
+    Rng generator;
+
+    size_t chunkCount;
+    std::vector<size_t> order;
+    // Next chunk of `order` to bring into the window
+    size_t nextChunk;
+    // Shuffled sample indices of the window; pending[position] is next
+    std::vector<uint64_t> pending;
+    size_t position;
+    // Chunks to drop once the current batch has been read from them
+    std::vector<size_t> retiring;
+    std::vector<size_t> current;
+
+    std::vector<double, AlignedAllocator<double>> inputs;
+    std::vector<double, AlignedAllocator<double>> targets;
+
+    void adviseChunk(size_t chunk, bool need) const {
+        const uint64_t scalar = model::scalarSize(file.scalarType());
+        const uint64_t first = chunk * chunkSize;
+        const uint64_t n = std::min<uint64_t>(chunkSize, file.size() - first);
+        const uint64_t featureBytes = file.inputSize() * scalar;
+        const uint64_t labelBytes = file.outputSize() * scalar;
+        const uint64_t featureStart = file.layout.featureOffset + first * featureBytes;
+        const uint64_t labelStart = file.layout.labelOffset + first * labelBytes;
+        if (need) {
+            file.mapping->willNeed(featureStart, n * featureBytes);
+            file.mapping->willNeed(labelStart, n * labelBytes);
+        } else {
+            file.mapping->dontNeed(featureStart, n * featureBytes);
+            file.mapping->dontNeed(labelStart, n * labelBytes);
+        }
+    }
+
+    // Moves the next window of chunks in behind the samples still pending,
+    // and starts paging in the window after it
+    void fillWindow() {
+        pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(position));
+        position = 0;
+        retiring.insert(retiring.end(), current.begin(), current.end());
+        current.clear();
+
+        const size_t fresh = pending.size();
+        const size_t end = std::min(nextChunk + window, chunkCount);
+        for (; nextChunk < end; ++nextChunk) {
+            const size_t chunk = order[nextChunk];
+            const uint64_t first = static_cast<uint64_t>(chunk) * chunkSize;
+            const uint64_t last = std::min<uint64_t>(first + chunkSize, file.size());
+            for (uint64_t i = first; i < last; ++i) {
+                pending.push_back(i);
+            }
+            current.push_back(chunk);
+        }
+        generator.shuffle(pending.begin() + static_cast<std::ptrdiff_t>(fresh), pending.end());
+
+        for (size_t k = nextChunk; k < std::min(nextChunk + window, chunkCount); ++k) {
+            adviseChunk(order[k], true);
+        }
+    }
+
+    template <typename T>
+    DatasetView gather(const T* features, const T* labels, const uint64_t* samples, size_t n) {
+        const size_t inputWidth = file.inputSize();
+        const size_t outputWidth = file.outputSize();
+        for (size_t b = 0; b < n; ++b) {
+            std::copy_n(features + samples[b] * inputWidth, inputWidth, inputs.data() + b * inputWidth);
+            std::copy_n(labels + samples[b] * outputWidth, outputWidth, targets.data() + b * outputWidth);
+        }
+        return DatasetView(inputs.data(), targets.data(), n, inputWidth, outputWidth);
+    }
+
+    DatasetView gather(const uint64_t* samples, size_t n) {
+        if (file.scalarType() == ScalarType::Float64) {
+            return gather(file.features<double>(), file.labels<double>(), samples, n);
+        }
+        return gather(file.features<float>(), file.labels<float>(), samples, n);
+    }
+
+public:
+    Loader(File file, size_t batchSize, bool shuffle = true, size_t chunkSize = 4096, size_t window = 16,
+           Rng generator = rng::stream())
+    : file(std::move(file)), batchSize(std::max<size_t>(batchSize, 1)), shuffle(shuffle),
+    chunkSize(std::max<size_t>(chunkSize, 1)), window(std::max<size_t>(window, 1)), generator(generator),
+    nextChunk(0), position(0) {
+        chunkCount = (this->file.size() + this->chunkSize - 1) / this->chunkSize;
+        order.resize(chunkCount);
+        std::iota(order.begin(), order.end(), 0);
+        inputs.resize(this->batchSize * this->file.inputSize());
+        targets.resize(this->batchSize * this->file.outputSize());
+        this->file.mapping->expect(!shuffle);
+        rewind();
+    }
+
+    size_t size() const { return file.size(); }
+    size_t inputSize() const override { return file.inputSize(); }
+    size_t outputSize() const override { return file.outputSize(); }
+    size_t batchesPerEpoch() const { return (file.size() + batchSize - 1) / batchSize; }
+
+    void rewind() override {
+        for (size_t chunk : retiring) adviseChunk(chunk, false);
+        for (size_t chunk : current) adviseChunk(chunk, false);
+        retiring.clear();
+        current.clear();
+        pending.clear();
+        position = 0;
+        nextChunk = 0;
+        if (shuffle) {
+            generator.shuffle(order.begin(), order.end());
+            for (size_t k = 0; k < std::min(window, chunkCount); ++k) {
+                adviseChunk(order[k], true);
+            }
+        }
+    }
+
+    DatasetView next() override {
+        if (!shuffle) {
+            // In order: the next batchSize samples, position counting samples
+            const uint64_t first = position;
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(batchSize, file.size() - first));
+            position += n;
+            if (file.scalarType() == ScalarType::Float64) {
+                return file.view().batch(first, n);
+            }
+            const size_t inputWidth = file.inputSize();
+            const size_t outputWidth = file.outputSize();
+            std::copy_n(file.features<float>() + first * inputWidth, n * inputWidth, inputs.data());
+            std::copy_n(file.labels<float>() + first * outputWidth, n * outputWidth, targets.data());
+            return DatasetView(inputs.data(), targets.data(), n, inputWidth, outputWidth);
+        }
+
+        while (pending.size() - position < batchSize && nextChunk < chunkCount) {
+            fillWindow();
+        }
+        const size_t n = std::min(batchSize, pending.size() - position);
+        const DatasetView batch = gather(pending.data() + position, n);
+        position += n;
+
+        // The batch has been copied out, so chunks of the last window are
+        // done with
+        for (size_t chunk : retiring) adviseChunk(chunk, false);
+        retiring.clear();
+        return batch;
+    }
+};
+
+} // namespace dataset
+
+#endif /* dataset_file_hpp */
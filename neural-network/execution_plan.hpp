@@ -0,0 +1,249 @@
+//
+//  execution_plan.hpp
+//  neural-network
+//
+//  Frozen schedule for a pass through a fully connected network. Compiling
+//  a plan works out, once per architecture, which kernels a training step
+//  or a prediction runs and in what order, and where in a single scratch
+//  buffer each intermediate (layer outputs, kept pre-activation sums,
+//  deltas, gradients) lives. Buffers whose lifetimes don't overlap share
+//  memory, so a step replays a fixed list of kernel calls over fixed
+//  offsets instead of carving out and tracking a matrix per intermediate.
+//
+//  Intermediates with one column per sample are laid out per sample: their
+//  offsets are multiplied by the batch size, so one plan serves every
+//  batch size and a batch of n needs size(n) values of scratch.
+//
+
+#ifndef execution_plan_hpp
+#define execution_plan_hpp
+
+#include "activation.hpp"
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+// Offsets for a set of buffers, each used over a span of steps. Packing
+// places the largest buffers first, each at the lowest offset that doesn't
+// overlap a buffer live at the same time.
+class BufferLayout {
+public:
+    static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+
+    // Registers a buffer of `elements` values per sample (times the batch
+    // size) or, when perSample is false, of `elements` values in total
+    size_t add(size_t elements, bool perSample) {
+        buffers.push_back(Buffer{elements, perSample, NONE, 0, 0});
+        return buffers.size() - 1;
+    }
+
+    // The buffer is read or written at step `time`
+    void use(size_t buffer, size_t time) {
+        if (buffer == NONE) return;
+        Buffer& b = buffers[buffer];
+        b.first = std::min(b.first, time);
+        b.last = std::max(b.last, time);
+    }
+
+    // Assigns offsets, each rounded to a multiple of `alignment` values
+    void pack(size_t alignment) {
+        perSampleSize = packGroup(true, alignment);
+        fixedSize = packGroup(false, alignment);
+    }
+
+    size_t offset(size_t buffer, size_t batch) const {
+        const Buffer& b = buffers[buffer];
+        return b.perSample ? b.offset * batch : perSampleSize * batch + b.offset;
+    }
+
+    // Values of scratch a batch of `batch` samples needs
+    size_t size(size_t batch) const {
+        return perSampleSize * batch + fixedSize;
+    }
+
+    // Values the buffers would take without sharing, for comparison
+    size_t unsharedSize(size_t batch) const {
+        size_t total = 0;
+        for (const Buffer& b : buffers) {
+            total += b.perSample ? b.elements * batch : b.elements;
+        }
+        return total;
+    }
+
+private:
+    struct Buffer {
+        size_t elements;
+        bool perSample;
+        size_t first;
+        size_t last;
+        size_t offset;
+    };
+
+    std::vector<Buffer> buffers;
+    size_t perSampleSize = 0;
+    size_t fixedSize = 0;
+
+    size_t packGroup(bool perSample, size_t alignment) {
+        std::vector<size_t> order;
+        for (size_t k = 0; k < buffers.size(); ++k) {
+            if (buffers[k].perSample == perSample && buffers[k].first != NONE) {
+                order.push_back(k);
+            }
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return buffers[a].elements > buffers[b].elements;
+        });
+
+        size_t total = 0;
+        std::vector<size_t> placed;
+        for (size_t k : order) {
+            Buffer& buffer = buffers[k];
+            const size_t length = (buffer.elements + alignment - 1) / alignment * alignment;
+            // Lowest gap among the placed buffers live at the same time
+            std::vector<size_t> live;
+            for (size_t p : placed) {
+                if (buffers[p].first <= buffer.last && buffer.first <= buffers[p].last) {
+                    live.push_back(p);
+                }
+            }
+            std::sort(live.begin(), live.end(), [&](size_t a, size_t b) {
+                return buffers[a].offset < buffers[b].offset;
+            });
+            size_t offset = 0;
+            for (size_t p : live) {
+                if (offset + length <= buffers[p].offset) break;
+                const size_t end = buffers[p].offset + (buffers[p].elements + alignment - 1) / alignment * alignment;
+                offset = std::max(offset, end);
+            }
+            buffer.offset = offset;
+            total = std::max(total, offset + length);
+            placed.push_back(k);
+        }
+        return total;
+    }
+};
+
+// Kernel calls of a training step or a prediction, and the buffers they
+// work on. Layer i maps activations[i] to activations[i + 1].
+struct ExecutionPlan {
+    enum class Op {
+        // z = W a + b, then the activation, fused over the batch
+        Forward,
+        // delta = (a - target) * f'(z) for the output layer, accumulating
+        // the squared error in the same pass
+        OutputDelta,
+        // delta[i] = (W[i + 1]^T delta[i + 1]) * f'(z)
+        BackDelta,
+        // Gradient of layer i and the optimizer step
+        Update
+    };
+    struct Step {
+        Op op;
+        size_t layer;
+    };
+
+    std::vector<Step> steps;
+    BufferLayout layout;
+    // Buffer ids (BufferLayout::NONE where there is none). activations[0]
+    // is the input; sums[i] is the buffer a layer's sums go to, which is
+    // activations[i + 1] unless the backward pass needs them kept.
+    std::vector<size_t> activations;
+    std::vector<size_t> sums;
+    std::vector<size_t> deltas;
+    size_t weightGradient = BufferLayout::NONE;
+    size_t biasGradient = BufferLayout::NONE;
+
+    // A training step: the forward pass, then from the output back each
+    // layer's delta followed by the update of the layer above it, so every
+    // delta and activation dies as soon as its layer has been updated.
+    // `gradients` reserves a buffer for the weight gradient, which plain
+    // SGD folds into the update GEMM instead.
+    static ExecutionPlan training(const std::vector<size_t>& layers, const std::vector<Activation>& functions,
+                                  bool gradients, size_t alignment) {
+        const size_t count = layers.size() - 1;
+        ExecutionPlan plan;
+        plan.addForward(layers, functions, true, true);
+        plan.steps.push_back(Step{Op::OutputDelta, count - 1});
+        for (size_t i = count; i-- > 0;) {
+            if (i > 0) {
+                plan.steps.push_back(Step{Op::BackDelta, i - 1});
+            }
+            plan.steps.push_back(Step{Op::Update, i});
+        }
+
+        size_t widest = 0;
+        size_t largest = 0;
+        for (size_t i = 0; i < count; ++i) {
+            plan.deltas.push_back(plan.layout.add(layers[i + 1], true));
+            widest = std::max(widest, layers[i + 1]);
+            largest = std::max(largest, layers[i + 1] * layers[i]);
+        }
+        plan.biasGradient = plan.layout.add(widest, false);
+        if (gradients) {
+            plan.weightGradient = plan.layout.add(largest, false);
+        }
+
+        for (size_t t = 0; t < plan.steps.size(); ++t) {
+            const size_t i = plan.steps[t].layer;
+            switch (plan.steps[t].op) {
+                case Op::Forward:
+                    plan.layout.use(plan.activations[i], t);
+                    plan.layout.use(plan.sums[i], t);
+                    plan.layout.use(plan.activations[i + 1], t);
+                    break;
+                case Op::OutputDelta:
+                case Op::BackDelta:
+                    if (plan.steps[t].op == Op::BackDelta) {
+                        plan.layout.use(plan.deltas[i + 1], t);
+                    }
+                    plan.layout.use(plan.activations[i + 1], t);
+                    plan.layout.use(plan.sums[i], t);
+                    plan.layout.use(plan.deltas[i], t);
+                    break;
+                case Op::Update:
+                    plan.layout.use(plan.activations[i], t);
+                    plan.layout.use(plan.deltas[i], t);
+                    plan.layout.use(plan.biasGradient, t);
+                    plan.layout.use(plan.weightGradient, t);
+                    break;
+            }
+        }
+        plan.layout.pack(alignment);
+        return plan;
+    }
+
+    // Prediction: the forward pass alone, every layer activated in place.
+    // With ownInput the input is converted into the plan's scratch;
+    // otherwise it is read where the caller keeps it.
+    static ExecutionPlan inference(const std::vector<size_t>& layers, const std::vector<Activation>& functions,
+                                   bool ownInput, size_t alignment) {
+        ExecutionPlan plan;
+        plan.addForward(layers, functions, ownInput, false);
+        for (size_t t = 0; t < plan.steps.size(); ++t) {
+            const size_t i = plan.steps[t].layer;
+            plan.layout.use(plan.activations[i], t);
+            plan.layout.use(plan.activations[i + 1], t);
+        }
+        // The output is read after the last step
+        plan.layout.use(plan.activations.back(), plan.steps.size());
+        plan.layout.pack(alignment);
+        return plan;
+    }
+
+private:
+    void addForward(const std::vector<size_t>& layers, const std::vector<Activation>& functions,
+                    bool ownInput, bool keepSums) {
+        activations.push_back(ownInput ? layout.add(layers[0], true) : BufferLayout::NONE);
+        for (size_t i = 0; i + 1 < layers.size(); ++i) {
+            const size_t output = layout.add(layers[i + 1], true);
+            const bool kept = keepSums && activation::needsInput(functions[i]);
+            sums.push_back(kept ? layout.add(layers[i + 1], true) : output);
+            activations.push_back(output);
+            steps.push_back(Step{Op::Forward, i});
+        }
+    }
+};
+
+#endif /* execution_plan_hpp */
@@ -0,0 +1,855 @@
+//
+//  gemm.hpp
+//  neural-network
+//
+//  Cache-blocked matrix multiply with register-tiled SIMD micro-kernels.
+//
+//  The blocked path follows the usual GotoBLAS/BLIS layout: B is packed into
+//  KC x NC panels that stay in L2/L3, A into MC x KC panels that stay in L2,
+//  and a micro-kernel keeps an MR x NR tile of C in registers while streaming
+//  both packed panels through L1. The micro-kernel is chosen once at startup
+//  from the instruction sets the CPU reports (AVX-512, AVX2+FMA, SSE2), with a
+//  portable scalar kernel for every other target.
+//
+//  All entry points take explicit row and column strides, so a transposed
+//  operand is just a strided view and never needs to be copied first.
+//
+//  Large products are split by rows of C across the shared ThreadPool; each
+//  thread packs into its own thread-local buffers.
+//
+
+#ifndef gemm_hpp
+#define gemm_hpp
+
+#include "aligned_allocator.hpp"
+#include "thread_pool.hpp"
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define NN_GEMM_X86 1
+#include <immintrin.h>
+#endif
+
+namespace kernels {
+
+enum class Isa { Scalar, SSE2, AVX2, AVX512 };
+
+inline const char* isaName(Isa isa) {
+    switch (isa) {
+        case Isa::SSE2: return "SSE2";
+        case Isa::AVX2: return "AVX2";
+        case Isa::AVX512: return "AVX-512";
+        default: return "Scalar";
+    }
+}
+
+// Best instruction set both the compiler and the running CPU support
+inline Isa detectIsa() {
+#ifdef NN_GEMM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return Isa::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return Isa::AVX2;
+    if (__builtin_cpu_supports("sse2")) return Isa::SSE2;
+#endif
+    return Isa::Scalar;
+}
+
+// Active ISA. Defaults to detectIsa(); can be lowered for testing.
+inline Isa& activeIsa() {
+    static Isa isa = detectIsa();
+    return isa;
+}
+
+inline void setIsa(Isa isa) {
+    if (static_cast<int>(isa) > static_cast<int>(detectIsa())) {
+        throw std::invalid_argument(
+            std::string("CPU does not support ") + isaName(isa)
+        );
+    }
+    activeIsa() = isa;
+}
+
+// Cache blocking parameters (in elements). MC and NC are multiples of every
+// MR and NR below so full panels never straddle a block edge.
+constexpr size_t KC = 256;
+constexpr size_t MC = 96;
+constexpr size_t NC = 4032;
+
+// Largest MR * NR of any micro-kernel below
+constexpr size_t MAX_TILE = 8 * 32;
+
+// Products smaller than this (m * n * k) skip packing entirely
+constexpr size_t SMALL_GEMM = 16384;
+
+// C[0:MR, 0:NR] += alpha * Ap * Bp, where Ap is an MR-wide packed panel
+// and Bp an NR-wide packed panel, both of depth kc.
+template <typename T>
+using MicroKernel = void (*)(size_t kc, const T* Ap, const T* Bp, T* C, size_t ldc, T alpha);
+
+template <typename T>
+struct KernelSet {
+    size_t mr;
+    size_t nr;
+    MicroKernel<T> micro;
+    T (*dot)(size_t n, const T* x, const T* y);
+    void (*axpy)(size_t n, T alpha, const T* x, T* y);
+};
+
+// ---------------------------------------------------------------------------
+// Portable kernels
+// ---------------------------------------------------------------------------
+
+template <typename T, size_t MR, size_t NR>
+inline void microScalar(size_t kc, const T* Ap, const T* Bp, T* C, size_t ldc, T alpha) {
+    T ab[MR * NR] = {};
+    for (size_t p = 0; p < kc; ++p) {
+        for (size_t r = 0; r < MR; ++r) {
+            const T a = Ap[p * MR + r];
+            for (size_t c = 0; c < NR; ++c) {
+                ab[r * NR + c] += a * Bp[p * NR + c];
+            }
+        }
+    }
+    for (size_t r = 0; r < MR; ++r) {
+        for (size_t c = 0; c < NR; ++c) {
+            C[r * ldc + c] += alpha * ab[r * NR + c];
+        }
+    }
+}
+
+template <typename T>
+inline T dotScalar(size_t n, const T* x, const T* y) {
+    T s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += x[i] * y[i];
+        s1 += x[i + 1] * y[i + 1];
+        s2 += x[i + 2] * y[i + 2];
+        s3 += x[i + 3] * y[i + 3];
+    }
+    for (; i < n; ++i) {
+        s0 += x[i] * y[i];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+template <typename T>
+inline void axpyScalar(size_t n, T alpha, const T* x, T* y) {
+    for (size_t i = 0; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+// ---------------------------------------------------------------------------
+// x86 kernels (double)
+// ---------------------------------------------------------------------------
+
+#ifdef NN_GEMM_X86
+
+// 4x4 tile in eight 128-bit accumulators
+__attribute__((target("sse2")))
+inline void microSse2(size_t kc, const double* Ap, const double* Bp, double* C, size_t ldc, double alpha) {
+    __m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd();
+    __m128d c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd();
+    __m128d c20 = _mm_setzero_pd(), c21 = _mm_setzero_pd();
+    __m128d c30 = _mm_setzero_pd(), c31 = _mm_setzero_pd();
+    for (size_t p = 0; p < kc; ++p) {
+        const __m128d b0 = _mm_loadu_pd(Bp);
+        const __m128d b1 = _mm_loadu_pd(Bp + 2);
+        __m128d a;
+        a = _mm_set1_pd(Ap[0]); c00 = _mm_add_pd(c00, _mm_mul_pd(a, b0)); c01 = _mm_add_pd(c01, _mm_mul_pd(a, b1));
+        a = _mm_set1_pd(Ap[1]); c10 = _mm_add_pd(c10, _mm_mul_pd(a, b0)); c11 = _mm_add_pd(c11, _mm_mul_pd(a, b1));
+        a = _mm_set1_pd(Ap[2]); c20 = _mm_add_pd(c20, _mm_mul_pd(a, b0)); c21 = _mm_add_pd(c21, _mm_mul_pd(a, b1));
+        a = _mm_set1_pd(Ap[3]); c30 = _mm_add_pd(c30, _mm_mul_pd(a, b0)); c31 = _mm_add_pd(c31, _mm_mul_pd(a, b1));
+        Ap += 4;
+        Bp += 4;
+    }
+    const __m128d al = _mm_set1_pd(alpha);
+    _mm_storeu_pd(C, _mm_add_pd(_mm_loadu_pd(C), _mm_mul_pd(al, c00)));
+    _mm_storeu_pd(C + 2, _mm_add_pd(_mm_loadu_pd(C + 2), _mm_mul_pd(al, c01)));
+    _mm_storeu_pd(C + ldc, _mm_add_pd(_mm_loadu_pd(C + ldc), _mm_mul_pd(al, c10)));
+    _mm_storeu_pd(C + ldc + 2, _mm_add_pd(_mm_loadu_pd(C + ldc + 2), _mm_mul_pd(al, c11)));
+    _mm_storeu_pd(C + 2 * ldc, _mm_add_pd(_mm_loadu_pd(C + 2 * ldc), _mm_mul_pd(al, c20)));
+    _mm_storeu_pd(C + 2 * ldc + 2, _mm_add_pd(_mm_loadu_pd(C + 2 * ldc + 2), _mm_mul_pd(al, c21)));
+    _mm_storeu_pd(C + 3 * ldc, _mm_add_pd(_mm_loadu_pd(C + 3 * ldc), _mm_mul_pd(al, c30)));
+    _mm_storeu_pd(C + 3 * ldc + 2, _mm_add_pd(_mm_loadu_pd(C + 3 * ldc + 2), _mm_mul_pd(al, c31)));
+}
+
+__attribute__((target("sse2")))
+inline double dotSse2(size_t n, const double* x, const double* y) {
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+        s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(s0, s1));
+    double sum = lanes[0] + lanes[1];
+    for (; i < n; ++i) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+__attribute__((target("sse2")))
+inline void axpySse2(size_t n, double alpha, const double* x, double* y) {
+    const __m128d a = _mm_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(a, _mm_loadu_pd(x + i))));
+    }
+    for (; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+// 6x8 tile in twelve 256-bit accumulators. Written out by hand so the
+// accumulators stay in registers even without -O3 loop unrolling.
+__attribute__((target("avx2,fma")))
+inline void microAvx2(size_t kc, const double* Ap, const double* Bp, double* C, size_t ldc, double alpha) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+    for (size_t p = 0; p < kc; ++p) {
+        const __m256d b0 = _mm256_loadu_pd(Bp);
+        const __m256d b1 = _mm256_loadu_pd(Bp + 4);
+        __m256d a;
+        a = _mm256_broadcast_sd(Ap + 0); c00 = _mm256_fmadd_pd(a, b0, c00); c01 = _mm256_fmadd_pd(a, b1, c01);
+        a = _mm256_broadcast_sd(Ap + 1); c10 = _mm256_fmadd_pd(a, b0, c10); c11 = _mm256_fmadd_pd(a, b1, c11);
+        a = _mm256_broadcast_sd(Ap + 2); c20 = _mm256_fmadd_pd(a, b0, c20); c21 = _mm256_fmadd_pd(a, b1, c21);
+        a = _mm256_broadcast_sd(Ap + 3); c30 = _mm256_fmadd_pd(a, b0, c30); c31 = _mm256_fmadd_pd(a, b1, c31);
+        a = _mm256_broadcast_sd(Ap + 4); c40 = _mm256_fmadd_pd(a, b0, c40); c41 = _mm256_fmadd_pd(a, b1, c41);
+        a = _mm256_broadcast_sd(Ap + 5); c50 = _mm256_fmadd_pd(a, b0, c50); c51 = _mm256_fmadd_pd(a, b1, c51);
+        Ap += 6;
+        Bp += 8;
+    }
+    const __m256d al = _mm256_set1_pd(alpha);
+    _mm256_storeu_pd(C, _mm256_fmadd_pd(al, c00, _mm256_loadu_pd(C)));
+    _mm256_storeu_pd(C + 4, _mm256_fmadd_pd(al, c01, _mm256_loadu_pd(C + 4)));
+    _mm256_storeu_pd(C + ldc, _mm256_fmadd_pd(al, c10, _mm256_loadu_pd(C + ldc)));
+    _mm256_storeu_pd(C + ldc + 4, _mm256_fmadd_pd(al, c11, _mm256_loadu_pd(C + ldc + 4)));
+    _mm256_storeu_pd(C + 2 * ldc, _mm256_fmadd_pd(al, c20, _mm256_loadu_pd(C + 2 * ldc)));
+    _mm256_storeu_pd(C + 2 * ldc + 4, _mm256_fmadd_pd(al, c21, _mm256_loadu_pd(C + 2 * ldc + 4)));
+    _mm256_storeu_pd(C + 3 * ldc, _mm256_fmadd_pd(al, c30, _mm256_loadu_pd(C + 3 * ldc)));
+    _mm256_storeu_pd(C + 3 * ldc + 4, _mm256_fmadd_pd(al, c31, _mm256_loadu_pd(C + 3 * ldc + 4)));
+    _mm256_storeu_pd(C + 4 * ldc, _mm256_fmadd_pd(al, c40, _mm256_loadu_pd(C + 4 * ldc)));
+    _mm256_storeu_pd(C + 4 * ldc + 4, _mm256_fmadd_pd(al, c41, _mm256_loadu_pd(C + 4 * ldc + 4)));
+    _mm256_storeu_pd(C + 5 * ldc, _mm256_fmadd_pd(al, c50, _mm256_loadu_pd(C + 5 * ldc)));
+    _mm256_storeu_pd(C + 5 * ldc + 4, _mm256_fmadd_pd(al, c51, _mm256_loadu_pd(C + 5 * ldc + 4)));
+}
+
+__attribute__((target("avx2,fma")))
+inline double dotAvx2(size_t n, const double* x, const double* y) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), s0);
+        s1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4), s1);
+    }
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), s0);
+    }
+    s0 = _mm256_add_pd(s0, s1);
+    const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(s0), _mm256_extractf128_pd(s0, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    for (; i < n; ++i) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+inline void axpyAvx2(size_t n, double alpha, const double* x, double* y) {
+    const __m256d a = _mm256_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(a, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    }
+    for (; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+// 8x16 tile in sixteen 512-bit accumulators
+__attribute__((target("avx512f")))
+inline void microAvx512(size_t kc, const double* Ap, const double* Bp, double* C, size_t ldc, double alpha) {
+    __m512d c00 = _mm512_setzero_pd(), c01 = _mm512_setzero_pd();
+    __m512d c10 = _mm512_setzero_pd(), c11 = _mm512_setzero_pd();
+    __m512d c20 = _mm512_setzero_pd(), c21 = _mm512_setzero_pd();
+    __m512d c30 = _mm512_setzero_pd(), c31 = _mm512_setzero_pd();
+    __m512d c40 = _mm512_setzero_pd(), c41 = _mm512_setzero_pd();
+    __m512d c50 = _mm512_setzero_pd(), c51 = _mm512_setzero_pd();
+    __m512d c60 = _mm512_setzero_pd(), c61 = _mm512_setzero_pd();
+    __m512d c70 = _mm512_setzero_pd(), c71 = _mm512_setzero_pd();
+    for (size_t p = 0; p < kc; ++p) {
+        const __m512d b0 = _mm512_loadu_pd(Bp);
+        const __m512d b1 = _mm512_loadu_pd(Bp + 8);
+        __m512d a;
+        a = _mm512_set1_pd(Ap[0]); c00 = _mm512_fmadd_pd(a, b0, c00); c01 = _mm512_fmadd_pd(a, b1, c01);
+        a = _mm512_set1_pd(Ap[1]); c10 = _mm512_fmadd_pd(a, b0, c10); c11 = _mm512_fmadd_pd(a, b1, c11);
+        a = _mm512_set1_pd(Ap[2]); c20 = _mm512_fmadd_pd(a, b0, c20); c21 = _mm512_fmadd_pd(a, b1, c21);
+        a = _mm512_set1_pd(Ap[3]); c30 = _mm512_fmadd_pd(a, b0, c30); c31 = _mm512_fmadd_pd(a, b1, c31);
+        a = _mm512_set1_pd(Ap[4]); c40 = _mm512_fmadd_pd(a, b0, c40); c41 = _mm512_fmadd_pd(a, b1, c41);
+        a = _mm512_set1_pd(Ap[5]); c50 = _mm512_fmadd_pd(a, b0, c50); c51 = _mm512_fmadd_pd(a, b1, c51);
+        a = _mm512_set1_pd(Ap[6]); c60 = _mm512_fmadd_pd(a, b0, c60); c61 = _mm512_fmadd_pd(a, b1, c61);
+        a = _mm512_set1_pd(Ap[7]); c70 = _mm512_fmadd_pd(a, b0, c70); c71 = _mm512_fmadd_pd(a, b1, c71);
+        Ap += 8;
+        Bp += 16;
+    }
+    const __m512d al = _mm512_set1_pd(alpha);
+    _mm512_storeu_pd(C, _mm512_fmadd_pd(al, c00, _mm512_loadu_pd(C)));
+    _mm512_storeu_pd(C + 8, _mm512_fmadd_pd(al, c01, _mm512_loadu_pd(C + 8)));
+    _mm512_storeu_pd(C + ldc, _mm512_fmadd_pd(al, c10, _mm512_loadu_pd(C + ldc)));
+    _mm512_storeu_pd(C + ldc + 8, _mm512_fmadd_pd(al, c11, _mm512_loadu_pd(C + ldc + 8)));
+    _mm512_storeu_pd(C + 2 * ldc, _mm512_fmadd_pd(al, c20, _mm512_loadu_pd(C + 2 * ldc)));
+    _mm512_storeu_pd(C + 2 * ldc + 8, _mm512_fmadd_pd(al, c21, _mm512_loadu_pd(C + 2 * ldc + 8)));
+    _mm512_storeu_pd(C + 3 * ldc, _mm512_fmadd_pd(al, c30, _mm512_loadu_pd(C + 3 * ldc)));
+    _mm512_storeu_pd(C + 3 * ldc + 8, _mm512_fmadd_pd(al, c31, _mm512_loadu_pd(C + 3 * ldc + 8)));
+    _mm512_storeu_pd(C + 4 * ldc, _mm512_fmadd_pd(al, c40, _mm512_loadu_pd(C + 4 * ldc)));
+    _mm512_storeu_pd(C + 4 * ldc + 8, _mm512_fmadd_pd(al, c41, _mm512_loadu_pd(C + 4 * ldc + 8)));
+    _mm512_storeu_pd(C + 5 * ldc, _mm512_fmadd_pd(al, c50, _mm512_loadu_pd(C + 5 * ldc)));
+    _mm512_storeu_pd(C + 5 * ldc + 8, _mm512_fmadd_pd(al, c51, _mm512_loadu_pd(C + 5 * ldc + 8)));
+    _mm512_storeu_pd(C + 6 * ldc, _mm512_fmadd_pd(al, c60, _mm512_loadu_pd(C + 6 * ldc)));
+    _mm512_storeu_pd(C + 6 * ldc + 8, _mm512_fmadd_pd(al, c61, _mm512_loadu_pd(C + 6 * ldc + 8)));
+    _mm512_storeu_pd(C + 7 * ldc, _mm512_fmadd_pd(al, c70, _mm512_loadu_pd(C + 7 * ldc)));
+    _mm512_storeu_pd(C + 7 * ldc + 8, _mm512_fmadd_pd(al, c71, _mm512_loadu_pd(C + 7 * ldc + 8)));
+}
+
+__attribute__((target("avx512f")))
+inline double dotAvx512(size_t n, const double* x, const double* y) {
+    __m512d s = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s = _mm512_fmadd_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i), s);
+    }
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, s);
+    double sum = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    for (; i < n; ++i) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+inline void axpyAvx512(size_t n, double alpha, const double* x, double* y) {
+    const __m512d a = _mm512_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(y + i, _mm512_fmadd_pd(a, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+    }
+    for (; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+// ---------------------------------------------------------------------------
+// x86 kernels (float): same tile heights, twice the lanes per register
+// ---------------------------------------------------------------------------
+
+// 4x8 tile in 8 128-bit accumulators
+__attribute__((target("sse2")))
+inline void microSse2(size_t kc, const float* Ap, const float* Bp, float* C, size_t ldc, float alpha) {
+    __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+    __m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+    __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+    __m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+    for (size_t p = 0; p < kc; ++p) {
+        const __m128 b0 = _mm_loadu_ps(Bp);
+        const __m128 b1 = _mm_loadu_ps(Bp + 4);
+        __m128 a;
+        a = _mm_set1_ps(Ap[0]); c00 = _mm_add_ps(c00, _mm_mul_ps(a, b0)); c01 = _mm_add_ps(c01, _mm_mul_ps(a, b1));
+        a = _mm_set1_ps(Ap[1]); c10 = _mm_add_ps(c10, _mm_mul_ps(a, b0)); c11 = _mm_add_ps(c11, _mm_mul_ps(a, b1));
+        a = _mm_set1_ps(Ap[2]); c20 = _mm_add_ps(c20, _mm_mul_ps(a, b0)); c21 = _mm_add_ps(c21, _mm_mul_ps(a, b1));
+        a = _mm_set1_ps(Ap[3]); c30 = _mm_add_ps(c30, _mm_mul_ps(a, b0)); c31 = _mm_add_ps(c31, _mm_mul_ps(a, b1));
+        Ap += 4;
+        Bp += 8;
+    }
+    const __m128 al = _mm_set1_ps(alpha);
+    _mm_storeu_ps(C, _mm_add_ps(_mm_loadu_ps(C), _mm_mul_ps(al, c00)));
+    _mm_storeu_ps(C + 4, _mm_add_ps(_mm_loadu_ps(C + 4), _mm_mul_ps(al, c01)));
+    _mm_storeu_ps(C + ldc, _mm_add_ps(_mm_loadu_ps(C + ldc), _mm_mul_ps(al, c10)));
+    _mm_storeu_ps(C + ldc + 4, _mm_add_ps(_mm_loadu_ps(C + ldc + 4), _mm_mul_ps(al, c11)));
+    _mm_storeu_ps(C + 2 * ldc, _mm_add_ps(_mm_loadu_ps(C + 2 * ldc), _mm_mul_ps(al, c20)));
+    _mm_storeu_ps(C + 2 * ldc + 4, _mm_add_ps(_mm_loadu_ps(C + 2 * ldc + 4), _mm_mul_ps(al, c21)));
+    _mm_storeu_ps(C + 3 * ldc, _mm_add_ps(_mm_loadu_ps(C + 3 * ldc), _mm_mul_ps(al, c30)));
+    _mm_storeu_ps(C + 3 * ldc + 4, _mm_add_ps(_mm_loadu_ps(C + 3 * ldc + 4), _mm_mul_ps(al, c31)));
+}
+
+// 6x16 tile in 12 256-bit accumulators
+__attribute__((target("avx2,fma")))
+inline void microAvx2(size_t kc, const float* Ap, const float* Bp, float* C, size_t ldc, float alpha) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    for (size_t p = 0; p < kc; ++p) {
+        const __m256 b0 = _mm256_loadu_ps(Bp);
+        const __m256 b1 = _mm256_loadu_ps(Bp + 8);
+        __m256 a;
+        a = _mm256_set1_ps(Ap[0]); c00 = _mm256_fmadd_ps(a, b0, c00); c01 = _mm256_fmadd_ps(a, b1, c01);
+        a = _mm256_set1_ps(Ap[1]); c10 = _mm256_fmadd_ps(a, b0, c10); c11 = _mm256_fmadd_ps(a, b1, c11);
+        a = _mm256_set1_ps(Ap[2]); c20 = _mm256_fmadd_ps(a, b0, c20); c21 = _mm256_fmadd_ps(a, b1, c21);
+        a = _mm256_set1_ps(Ap[3]); c30 = _mm256_fmadd_ps(a, b0, c30); c31 = _mm256_fmadd_ps(a, b1, c31);
+        a = _mm256_set1_ps(Ap[4]); c40 = _mm256_fmadd_ps(a, b0, c40); c41 = _mm256_fmadd_ps(a, b1, c41);
+        a = _mm256_set1_ps(Ap[5]); c50 = _mm256_fmadd_ps(a, b0, c50); c51 = _mm256_fmadd_ps(a, b1, c51);
+        Ap += 6;
+        Bp += 16;
+    }
+    const __m256 al = _mm256_set1_ps(alpha);
+    _mm256_storeu_ps(C, _mm256_fmadd_ps(al, c00, _mm256_loadu_ps(C)));
+    _mm256_storeu_ps(C + 8, _mm256_fmadd_ps(al, c01, _mm256_loadu_ps(C + 8)));
+    _mm256_storeu_ps(C + ldc, _mm256_fmadd_ps(al, c10, _mm256_loadu_ps(C + ldc)));
+    _mm256_storeu_ps(C + ldc + 8, _mm256_fmadd_ps(al, c11, _mm256_loadu_ps(C + ldc + 8)));
+    _mm256_storeu_ps(C + 2 * ldc, _mm256_fmadd_ps(al, c20, _mm256_loadu_ps(C + 2 * ldc)));
+    _mm256_storeu_ps(C + 2 * ldc + 8, _mm256_fmadd_ps(al, c21, _mm256_loadu_ps(C + 2 * ldc + 8)));
+    _mm256_storeu_ps(C + 3 * ldc, _mm256_fmadd_ps(al, c30, _mm256_loadu_ps(C + 3 * ldc)));
+    _mm256_storeu_ps(C + 3 * ldc + 8, _mm256_fmadd_ps(al, c31, _mm256_loadu_ps(C + 3 * ldc + 8)));
+    _mm256_storeu_ps(C + 4 * ldc, _mm256_fmadd_ps(al, c40, _mm256_loadu_ps(C + 4 * ldc)));
+    _mm256_storeu_ps(C + 4 * ldc + 8, _mm256_fmadd_ps(al, c41, _mm256_loadu_ps(C + 4 * ldc + 8)));
+    _mm256_storeu_ps(C + 5 * ldc, _mm256_fmadd_ps(al, c50, _mm256_loadu_ps(C + 5 * ldc)));
+    _mm256_storeu_ps(C + 5 * ldc + 8, _mm256_fmadd_ps(al, c51, _mm256_loadu_ps(C + 5 * ldc + 8)));
+}
+
+// 8x32 tile in 16 512-bit accumulators
+__attribute__((target("avx512f")))
+inline void microAvx512(size_t kc, const float* Ap, const float* Bp, float* C, size_t ldc, float alpha) {
+    __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+    __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+    __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+    __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+    __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+    __m512 c60 = _mm512_setzero_ps(), c61 = _mm512_setzero_ps();
+    __m512 c70 = _mm512_setzero_ps(), c71 = _mm512_setzero_ps();
+    for (size_t p = 0; p < kc; ++p) {
+        const __m512 b0 = _mm512_loadu_ps(Bp);
+        const __m512 b1 = _mm512_loadu_ps(Bp + 16);
+        __m512 a;
+        a = _mm512_set1_ps(Ap[0]); c00 = _mm512_fmadd_ps(a, b0, c00); c01 = _mm512_fmadd_ps(a, b1, c01);
+        a = _mm512_set1_ps(Ap[1]); c10 = _mm512_fmadd_ps(a, b0, c10); c11 = _mm512_fmadd_ps(a, b1, c11);
+        a = _mm512_set1_ps(Ap[2]); c20 = _mm512_fmadd_ps(a, b0, c20); c21 = _mm512_fmadd_ps(a, b1, c21);
+        a = _mm512_set1_ps(Ap[3]); c30 = _mm512_fmadd_ps(a, b0, c30); c31 = _mm512_fmadd_ps(a, b1, c31);
+        a = _mm512_set1_ps(Ap[4]); c40 = _mm512_fmadd_ps(a, b0, c40); c41 = _mm512_fmadd_ps(a, b1, c41);
+        a = _mm512_set1_ps(Ap[5]); c50 = _mm512_fmadd_ps(a, b0, c50); c51 = _mm512_fmadd_ps(a, b1, c51);
+        a = _mm512_set1_ps(Ap[6]); c60 = _mm512_fmadd_ps(a, b0, c60); c61 = _mm512_fmadd_ps(a, b1, c61);
+        a = _mm512_set1_ps(Ap[7]); c70 = _mm512_fmadd_ps(a, b0, c70); c71 = _mm512_fmadd_ps(a, b1, c71);
+        Ap += 8;
+        Bp += 32;
+    }
+    const __m512 al = _mm512_set1_ps(alpha);
+    _mm512_storeu_ps(C, _mm512_fmadd_ps(al, c00, _mm512_loadu_ps(C)));
+    _mm512_storeu_ps(C + 16, _mm512_fmadd_ps(al, c01, _mm512_loadu_ps(C + 16)));
+    _mm512_storeu_ps(C + ldc, _mm512_fmadd_ps(al, c10, _mm512_loadu_ps(C + ldc)));
+    _mm512_storeu_ps(C + ldc + 16, _mm512_fmadd_ps(al, c11, _mm512_loadu_ps(C + ldc + 16)));
+    _mm512_storeu_ps(C + 2 * ldc, _mm512_fmadd_ps(al, c20, _mm512_loadu_ps(C + 2 * ldc)));
+    _mm512_storeu_ps(C + 2 * ldc + 16, _mm512_fmadd_ps(al, c21, _mm512_loadu_ps(C + 2 * ldc + 16)));
+    _mm512_storeu_ps(C + 3 * ldc, _mm512_fmadd_ps(al, c30, _mm512_loadu_ps(C + 3 * ldc)));
+    _mm512_storeu_ps(C + 3 * ldc + 16, _mm512_fmadd_ps(al, c31, _mm512_loadu_ps(C + 3 * ldc + 16)));
+    _mm512_storeu_ps(C + 4 * ldc, _mm512_fmadd_ps(al, c40, _mm512_loadu_ps(C + 4 * ldc)));
+    _mm512_storeu_ps(C + 4 * ldc + 16, _mm512_fmadd_ps(al, c41, _mm512_loadu_ps(C + 4 * ldc + 16)));
+    _mm512_storeu_ps(C + 5 * ldc, _mm512_fmadd_ps(al, c50, _mm512_loadu_ps(C + 5 * ldc)));
+    _mm512_storeu_ps(C + 5 * ldc + 16, _mm512_fmadd_ps(al, c51, _mm512_loadu_ps(C + 5 * ldc + 16)));
+    _mm512_storeu_ps(C + 6 * ldc, _mm512_fmadd_ps(al, c60, _mm512_loadu_ps(C + 6 * ldc)));
+    _mm512_storeu_ps(C + 6 * ldc + 16, _mm512_fmadd_ps(al, c61, _mm512_loadu_ps(C + 6 * ldc + 16)));
+    _mm512_storeu_ps(C + 7 * ldc, _mm512_fmadd_ps(al, c70, _mm512_loadu_ps(C + 7 * ldc)));
+    _mm512_storeu_ps(C + 7 * ldc + 16, _mm512_fmadd_ps(al, c71, _mm512_loadu_ps(C + 7 * ldc + 16)));
+}
+
+__attribute__((target("sse2")))
+inline float dotSse2(size_t n, const float* x, const float* y) {
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(s0, s1));
+    float sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; ++i) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+__attribute__((target("sse2")))
+inline void axpySse2(size_t n, float alpha, const float* x, float* y) {
+    const __m128 a = _mm_set1_ps(alpha);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(a, _mm_loadu_ps(x + i))));
+    }
+    for (; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline float dotAvx2(size_t n, const float* x, const float* y) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), s1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_add_ps(s0, s1));
+    float sum = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    for (; i < n; ++i) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+inline void axpyAvx2(size_t n, float alpha, const float* x, float* y) {
+    const __m256 a = _mm256_set1_ps(alpha);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(a, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    }
+    for (; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+__attribute__((target("avx512f")))
+inline float dotAvx512(size_t n, const float* x, const float* y) {
+    __m512 s = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        s = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), s);
+    }
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, s);
+    float sum = 0.0f;
+    for (int l = 0; l < 16; ++l) {
+        sum += lanes[l];
+    }
+    for (; i < n; ++i) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+inline void axpyAvx512(size_t n, float alpha, const float* x, float* y) {
+    const __m512 a = _mm512_set1_ps(alpha);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(y + i, _mm512_fmadd_ps(a, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+    }
+    for (; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+#endif /* NN_GEMM_X86 */
+
+// Kernel table for the active ISA
+template <typename T>
+inline KernelSet<T> kernelSet() {
+    return {4, 4, &microScalar<T, 4, 4>, &dotScalar<T>, &axpyScalar<T>};
+}
+
+template <>
+inline KernelSet<double> kernelSet<double>() {
+#ifdef NN_GEMM_X86
+    switch (activeIsa()) {
+        case Isa::AVX512: return {8, 16, &microAvx512, &dotAvx512, &axpyAvx512};
+        case Isa::AVX2: return {6, 8, &microAvx2, &dotAvx2, &axpyAvx2};
+        case Isa::SSE2: return {4, 4, &microSse2, &dotSse2, &axpySse2};
+        default: break;
+    }
+#endif
+    return {4, 4, &microScalar<double, 4, 4>, &dotScalar<double>, &axpyScalar<double>};
+}
+
+template <>
+inline KernelSet<float> kernelSet<float>() {
+#ifdef NN_GEMM_X86
+    switch (activeIsa()) {
+        case Isa::AVX512: return {8, 32, &microAvx512, &dotAvx512, &axpyAvx512};
+        case Isa::AVX2: return {6, 16, &microAvx2, &dotAvx2, &axpyAvx2};
+        case Isa::SSE2: return {4, 8, &microSse2, &dotSse2, &axpySse2};
+        default: break;
+    }
+#endif
+    return {4, 8, &microScalar<float, 4, 8>, &dotScalar<float>, &axpyScalar<float>};
+}
+
+// ---------------------------------------------------------------------------
+// Level 1 / Level 2
+// ---------------------------------------------------------------------------
+
+template <typename T>
+inline T dot(size_t n, const T* x, const T* y) {
+    return kernelSet<T>().dot(n, x, y);
+}
+
+// y += alpha * x
+template <typename T>
+inline void axpy(size_t n, T alpha, const T* x, T* y) {
+    kernelSet<T>().axpy(n, alpha, x, y);
+}
+
+// y = beta * y, treating beta == 0 as an overwrite so stale NaNs don't leak
+template <typename T>
+inline void scale(size_t n, T beta, T* y, size_t incy = 1) {
+    if (beta == T(1)) return;
+    for (size_t i = 0; i < n; ++i) {
+        y[i * incy] = beta == T(0) ? T(0) : beta * y[i * incy];
+    }
+}
+
+// y = alpha * A x + beta * y, A is m x n with strides (rsA, csA)
+template <typename T>
+inline void gemv(size_t m, size_t n, T alpha,
+                 const T* A, size_t rsA, size_t csA,
+                 const T* x, size_t incx,
+                 T beta, T* y, size_t incy) {
+    scale(m, beta, y, incy);
+    if (alpha == T(0) || n == 0) return;
+    const KernelSet<T> ks = kernelSet<T>();
+
+    if (csA == 1 && incx == 1) {
+        // Row-major A: one contiguous dot product per output
+        for (size_t i = 0; i < m; ++i) {
+            y[i * incy] += alpha * ks.dot(n, A + i * rsA, x);
+        }
+    } else if (rsA == 1 && incy == 1) {
+        // Column-major A (e.g. a transposed view): accumulate columns
+        for (size_t j = 0; j < n; ++j) {
+            ks.axpy(m, alpha * x[j * incx], A + j * csA, y);
+        }
+    } else {
+        for (size_t i = 0; i < m; ++i) {
+            T sum = 0;
+            for (size_t j = 0; j < n; ++j) {
+                sum += A[i * rsA + j * csA] * x[j * incx];
+            }
+            y[i * incy] += alpha * sum;
+        }
+    }
+}
+
+// A += alpha * x y^T (rank-1 update), A is m x n row-major with leading dim lda
+template <typename T>
+inline void ger(size_t m, size_t n, T alpha,
+                const T* x, size_t incx,
+                const T* y, size_t incy,
+                T* A, size_t lda) {
+    if (alpha == T(0)) return;
+    const KernelSet<T> ks = kernelSet<T>();
+    for (size_t i = 0; i < m; ++i) {
+        const T ax = alpha * x[i * incx];
+        T* row = A + i * lda;
+        if (incy == 1) {
+            ks.axpy(n, ax, y, row);
+        } else {
+            for (size_t j = 0; j < n; ++j) {
+                row[j] += ax * y[j * incy];
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Level 3
+// ---------------------------------------------------------------------------
+
+// Per-thread packing buffers; they only grow, so steady state never allocates
+template <typename T>
+inline std::vector<T, AlignedAllocator<T>>& packBufferA() {
+    thread_local std::vector<T, AlignedAllocator<T>> buf;
+    return buf;
+}
+
+template <typename T>
+inline std::vector<T, AlignedAllocator<T>>& packBufferB() {
+    thread_local std::vector<T, AlignedAllocator<T>> buf;
+    return buf;
+}
+
+// Pack an mc x kc block of A into MR-row panels, zero padding the last one
+template <typename T>
+inline void packA(size_t mc, size_t kc, const T* A, size_t rsA, size_t csA, size_t mr, T* out) {
+    for (size_t i = 0; i < mc; i += mr) {
+        const size_t rows = std::min(mr, mc - i);
+        for (size_t p = 0; p < kc; ++p) {
+            for (size_t r = 0; r < rows; ++r) {
+                out[r] = A[(i + r) * rsA + p * csA];
+            }
+            for (size_t r = rows; r < mr; ++r) {
+                out[r] = T(0);
+            }
+            out += mr;
+        }
+    }
+}
+
+// Pack a kc x nc block of B into NR-column panels, zero padding the last one
+template <typename T>
+inline void packB(size_t kc, size_t nc, const T* B, size_t rsB, size_t csB, size_t nr, T* out) {
+    for (size_t j = 0; j < nc; j += nr) {
+        const size_t cols = std::min(nr, nc - j);
+        for (size_t p = 0; p < kc; ++p) {
+            const T* src = B + p * rsB + j * csB;
+            if (csB == 1) {
+                std::copy(src, src + cols, out);
+            } else {
+                for (size_t c = 0; c < cols; ++c) {
+                    out[c] = src[c * csB];
+                }
+            }
+            for (size_t c = cols; c < nr; ++c) {
+                out[c] = T(0);
+            }
+            out += nr;
+        }
+    }
+}
+
+// Small products: unpacked i-k-j loop over C rows
+template <typename T>
+inline void gemmSmall(size_t m, size_t n, size_t k, T alpha,
+                      const T* A, size_t rsA, size_t csA,
+                      const T* B, size_t rsB, size_t csB,
+                      T* C, size_t ldc) {
+    const KernelSet<T> ks = kernelSet<T>();
+    for (size_t i = 0; i < m; ++i) {
+        T* row = C + i * ldc;
+        for (size_t p = 0; p < k; ++p) {
+            const T a = alpha * A[i * rsA + p * csA];
+            if (csB == 1) {
+                ks.axpy(n, a, B + p * rsB, row);
+            } else {
+                for (size_t j = 0; j < n; ++j) {
+                    row[j] += a * B[p * rsB + j * csB];
+                }
+            }
+        }
+    }
+}
+
+// C += alpha * A B through packed panels and the micro-kernel
+template <typename T>
+inline void gemmBlocked(size_t m, size_t n, size_t k, T alpha,
+                        const T* A, size_t rsA, size_t csA,
+                        const T* B, size_t rsB, size_t csB,
+                        T* C, size_t ldc) {
+    const KernelSet<T> ks = kernelSet<T>();
+    const size_t mr = ks.mr;
+    const size_t nr = ks.nr;
+    auto& bufA = packBufferA<T>();
+    auto& bufB = packBufferB<T>();
+    const size_t needA = MC * KC;
+    const size_t needB = KC * ((std::min(NC, n) + nr - 1) / nr * nr);
+    if (bufA.size() < needA) bufA.resize(needA);
+    if (bufB.size() < needB) bufB.resize(needB);
+    T edge[MAX_TILE];
+
+    for (size_t jc = 0; jc < n; jc += NC) {
+        const size_t nc = std::min(NC, n - jc);
+        for (size_t pc = 0; pc < k; pc += KC) {
+            const size_t kc = std::min(KC, k - pc);
+            packB(kc, nc, B + pc * rsB + jc * csB, rsB, csB, nr, bufB.data());
+
+            for (size_t ic = 0; ic < m; ic += MC) {
+                const size_t mc = std::min(MC, m - ic);
+                packA(mc, kc, A + ic * rsA + pc * csA, rsA, csA, mr, bufA.data());
+
+                for (size_t jr = 0; jr < nc; jr += nr) {
+                    const size_t cols = std::min(nr, nc - jr);
+                    const T* Bp = bufB.data() + jr * kc;
+                    for (size_t ir = 0; ir < mc; ir += mr) {
+                        const size_t rows = std::min(mr, mc - ir);
+                        const T* Ap = bufA.data() + ir * kc;
+                        T* Ct = C + (ic + ir) * ldc + jc + jr;
+                        if (rows == mr && cols == nr) {
+                            ks.micro(kc, Ap, Bp, Ct, ldc, alpha);
+                        } else {
+                            // Partial tile: run the full kernel into scratch
+                            std::fill(edge, edge + mr * nr, T(0));
+                            ks.micro(kc, Ap, Bp, edge, nr, alpha);
+                            for (size_t r = 0; r < rows; ++r) {
+                                for (size_t c = 0; c < cols; ++c) {
+                                    Ct[r * ldc + c] += edge[r * nr + c];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// C = alpha * A B + beta * C
+// A is m x k with strides (rsA, csA), B is k x n with strides (rsB, csB) and
+// C is m x n row-major with leading dimension ldc.
+template <typename T>
+inline void gemm(size_t m, size_t n, size_t k, T alpha,
+                 const T* A, size_t rsA, size_t csA,
+                 const T* B, size_t rsB, size_t csB,
+                 T beta, T* C, size_t ldc) {
+    if (m == 0 || n == 0) return;
+
+    // Matrix-vector shapes
+    if (n == 1) {
+        gemv(m, k, alpha, A, rsA, csA, B, rsB, beta, C, ldc);
+        return;
+    }
+    if (m == 1) {
+        // C^T = B^T A^T
+        gemv(n, k, alpha, B, csB, rsB, A, csA, beta, C, 1);
+        return;
+    }
+
+    for (size_t i = 0; i < m; ++i) {
+        scale(n, beta, C + i * ldc);
+    }
+    if (alpha == T(0) || k == 0) return;
+
+    // Outer product (e.g. delta * activation^T)
+    if (k == 1) {
+        ger(m, n, alpha, A, rsA, B, csB, C, ldc);
+        return;
+    }
+    if (m * n * k < SMALL_GEMM) {
+        gemmSmall(m, n, k, alpha, A, rsA, csA, B, rsB, csB, C, ldc);
+        return;
+    }
+
+    if (m * n * k < PARALLEL_GEMM_MIN) {
+        gemmBlocked(m, n, k, alpha, A, rsA, csA, B, rsB, csB, C, ldc);
+        return;
+    }
+
+    // Row-partitioned: each chunk is a whole number of MC row blocks, so
+    // threads never share a row of C or split a micro-tile
+    const size_t blocks = (m + MC - 1) / MC;
+    parallelFor(0, blocks, 1, [&](size_t lo, size_t hi) {
+        const size_t row = lo * MC;
+        const size_t rows = std::min(hi * MC, m) - row;
+        gemmBlocked(rows, n, k, alpha, A + row * rsA, rsA, csA, B, rsB, csB, C + row * ldc, ldc);
+    });
+}
+
+} // namespace kernels
+
+#endif /* gemm_hpp */
@@ -0,0 +1,265 @@
+//
+//  linalg.hpp
+//  neural-network
+//
+//  Linear-algebra backend used by Matrix. Every BLAS-shaped call Matrix
+//  makes (gemm, axpy, dot) goes through here and is forwarded to one of:
+//
+//    Builtin    the cache-blocked SIMD kernels in gemm.hpp (default)
+//    Cblas      a vendor CBLAS: Accelerate on Apple platforms, otherwise
+//               whatever <cblas.h> provides (OpenBLAS, BLIS, ...). Only
+//               compiled in when NN_USE_CBLAS is defined, since it needs the
+//               library linked (-framework Accelerate, -lopenblas, ...)
+//    Reference  plain loops with no blocking, vectorisation or threading,
+//               for checking the other two
+//
+//  The backend is picked at startup from NN_BACKEND (builtin, cblas or
+//  reference) when set, and can be changed at run time with setBackend().
+//  NN_DEFAULT_BACKEND overrides the compile-time default.
+//
+
+#ifndef linalg_hpp
+#define linalg_hpp
+
+#include "gemm.hpp"
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <type_traits>
+#include <stdexcept>
+
+#ifdef NN_USE_CBLAS
+#if defined(__APPLE__)
+#include <Accelerate/Accelerate.h>
+#else
+#include <cblas.h>
+#endif
+#endif
+
+#ifndef NN_DEFAULT_BACKEND
+#define NN_DEFAULT_BACKEND Builtin
+#endif
+
+namespace linalg {
+
+enum class Backend { Builtin, Cblas, Reference };
+
+inline const char* backendName(Backend backend) {
+    switch (backend) {
+        case Backend::Builtin: return "builtin";
+        case Backend::Cblas: return "cblas";
+        case Backend::Reference: return "reference";
+    }
+    return "unknown";
+}
+
+inline bool backendAvailable(Backend backend) {
+#ifdef NN_USE_CBLAS
+    (void)backend;
+    return true;
+#else
+    return backend != Backend::Cblas;
+#endif
+}
+
+inline Backend defaultBackend() {
+    if (const char* env = std::getenv("NN_BACKEND")) {
+        for (Backend b : {Backend::Builtin, Backend::Cblas, Backend::Reference}) {
+            if (std::strcmp(env, backendName(b)) == 0 && backendAvailable(b)) {
+                return b;
+            }
+        }
+    }
+    return backendAvailable(Backend::NN_DEFAULT_BACKEND) ? Backend::NN_DEFAULT_BACKEND : Backend::Builtin;
+}
+
+inline Backend& activeBackend() {
+    static Backend backend = defaultBackend();
+    return backend;
+}
+
+// Not thread-safe: switch backends between, not during, computations
+inline void setBackend(Backend backend) {
+    if (!backendAvailable(backend)) {
+        throw std::invalid_argument(
+            std::string("Linear-algebra backend not compiled in: ") + backendName(backend)
+        );
+    }
+    activeBackend() = backend;
+}
+
+// ---------------------------------------------------------------------------
+// Reference
+// ---------------------------------------------------------------------------
+
+namespace reference {
+
+template <typename T>
+inline void gemm(size_t m, size_t n, size_t k, T alpha,
+                 const T* A, size_t rsA, size_t csA,
+                 const T* B, size_t rsB, size_t csB,
+                 T beta, T* C, size_t ldc) {
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            T sum = T(0);
+            for (size_t p = 0; p < k; ++p) {
+                sum += A[i * rsA + p * csA] * B[p * rsB + j * csB];
+            }
+            T& c = C[i * ldc + j];
+            c = alpha * sum + (beta == T(0) ? T(0) : beta * c);
+        }
+    }
+}
+
+template <typename T>
+inline void axpy(size_t n, T alpha, const T* x, T* y) {
+    for (size_t i = 0; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+template <typename T>
+inline T dot(size_t n, const T* x, const T* y) {
+    T sum = T(0);
+    for (size_t i = 0; i < n; ++i) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+} // namespace reference
+
+// ---------------------------------------------------------------------------
+// CBLAS
+// ---------------------------------------------------------------------------
+
+#ifdef NN_USE_CBLAS
+namespace cblas {
+
+// CBLAS wants each operand row-major with unit stride along one axis. A
+// column-major operand (unit row stride) is passed as the transpose of a
+// row-major one. Returns false when neither stride is 1.
+inline bool layout(size_t rows, size_t cols, size_t rs, size_t cs,
+                   CBLAS_TRANSPOSE& trans, int& ld) {
+    if (cs == 1 && (rs >= cols || rows <= 1)) {
+        trans = CblasNoTrans;
+        ld = static_cast<int>(std::max<size_t>(rs, std::max<size_t>(cols, 1)));
+        return true;
+    }
+    if (rs == 1 && (cs >= rows || cols <= 1)) {
+        trans = CblasTrans;
+        ld = static_cast<int>(std::max<size_t>(cs, std::max<size_t>(rows, 1)));
+        return true;
+    }
+    return false;
+}
+
+template <typename T>
+inline bool gemm(size_t m, size_t n, size_t k, T alpha,
+                 const T* A, size_t rsA, size_t csA,
+                 const T* B, size_t rsB, size_t csB,
+                 T beta, T* C, size_t ldc) {
+    CBLAS_TRANSPOSE ta, tb;
+    int lda, ldb;
+    if (!layout(m, k, rsA, csA, ta, lda) || !layout(k, n, rsB, csB, tb, ldb)) {
+        return false;
+    }
+    const int M = static_cast<int>(m), N = static_cast<int>(n), K = static_cast<int>(k);
+    const int LDC = static_cast<int>(std::max<size_t>(ldc, std::max<size_t>(n, 1)));
+    if constexpr (std::is_same_v<T, double>) {
+        cblas_dgemm(CblasRowMajor, ta, tb, M, N, K, alpha, A, lda, B, ldb, beta, C, LDC);
+    } else {
+        cblas_sgemm(CblasRowMajor, ta, tb, M, N, K, alpha, A, lda, B, ldb, beta, C, LDC);
+    }
+    return true;
+}
+
+template <typename T>
+inline void axpy(size_t n, T alpha, const T* x, T* y) {
+    if constexpr (std::is_same_v<T, double>) {
+        cblas_daxpy(static_cast<int>(n), alpha, x, 1, y, 1);
+    } else {
+        cblas_saxpy(static_cast<int>(n), alpha, x, 1, y, 1);
+    }
+}
+
+template <typename T>
+inline T dot(size_t n, const T* x, const T* y) {
+    if constexpr (std::is_same_v<T, double>) {
+        return cblas_ddot(static_cast<int>(n), x, 1, y, 1);
+    } else {
+        return cblas_sdot(static_cast<int>(n), x, 1, y, 1);
+    }
+}
+
+} // namespace cblas
+#endif
+
+// ---------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------
+
+// C = alpha * A B + beta * C, with the same conventions as kernels::gemm
+template <typename T>
+inline void gemm(size_t m, size_t n, size_t k, T alpha,
+                 const T* A, size_t rsA, size_t csA,
+                 const T* B, size_t rsB, size_t csB,
+                 T beta, T* C, size_t ldc) {
+    switch (activeBackend()) {
+        case Backend::Reference:
+            reference::gemm(m, n, k, alpha, A, rsA, csA, B, rsB, csB, beta, C, ldc);
+            return;
+        case Backend::Cblas:
+#ifdef NN_USE_CBLAS
+            if (m > 0 && n > 0 && cblas::gemm(m, n, k, alpha, A, rsA, csA, B, rsB, csB, beta, C, ldc)) {
+                return;
+            }
+#endif
+            // Fully strided operands: let the built-in kernels handle them
+            [[fallthrough]];
+        case Backend::Builtin:
+            break;
+    }
+    kernels::gemm(m, n, k, alpha, A, rsA, csA, B, rsB, csB, beta, C, ldc);
+}
+
+// y += alpha * x
+template <typename T>
+inline void axpy(size_t n, T alpha, const T* x, T* y) {
+    switch (activeBackend()) {
+        case Backend::Reference:
+            reference::axpy(n, alpha, x, y);
+            return;
+        case Backend::Cblas:
+#ifdef NN_USE_CBLAS
+            cblas::axpy(n, alpha, x, y);
+            return;
+#endif
+            [[fallthrough]];
+        case Backend::Builtin:
+            break;
+    }
+    kernels::axpy(n, alpha, x, y);
+}
+
+template <typename T>
+inline T dot(size_t n, const T* x, const T* y) {
+    switch (activeBackend()) {
+        case Backend::Reference:
+            return reference::dot(n, x, y);
+        case Backend::Cblas:
+#ifdef NN_USE_CBLAS
+            return cblas::dot(n, x, y);
+#endif
+            [[fallthrough]];
+        case Backend::Builtin:
+            break;
+    }
+    return kernels::dot(n, x, y);
+}
+
+} // namespace linalg
+
+#endif /* linalg_hpp */
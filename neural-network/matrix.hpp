@@ -11,169 +11,708 @@
 #include <vector>
 #include <iostream>
 #include <iomanip>
-#include <random>
 #include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+#include <memory>
+#include "aligned_allocator.hpp"
+#include "matrix_storage.hpp"
+#include "linalg.hpp"
+#include "thread_pool.hpp"
+#include "random.hpp"
 
-class Matrix {
+// Non-owning strided window onto a Matrix buffer. Element (i, j) lives at
+// ptr[i * rowStride + j * colStride], so rows, columns, sub-blocks and the
+// transpose are all views onto the same memory. T is the scalar type for a
+// mutable view and its const-qualified form for a read-only one.
+template <typename T>
+class StridedView {
 private:
-    std::vector<std::vector<double>> data;
+    T* ptr;
     size_t rows;
     size_t cols;
+    size_t rowStride;
+    size_t colStride;
 
 public:
-    // Constructors
-    Matrix() : rows(0), cols(0) {
-        data.resize(0);
+    using Scalar = std::remove_const_t<T>;
+
+    // Empty view
+    StridedView() : ptr(nullptr), rows(0), cols(0), rowStride(0), colStride(1) {}
+    StridedView(T* ptr, size_t rows, size_t cols, size_t rowStride, size_t colStride)
+    : ptr(ptr), rows(rows), cols(cols), rowStride(rowStride), colStride(colStride) {}
+
+    // A mutable view converts to a read-only one
+    template <typename U, typename = std::enable_if_t<std::is_same_v<const U, T>>>
+    StridedView(const StridedView<U>& other)
+    : ptr(other.data()), rows(other.numRows()), cols(other.numCols()),
+    rowStride(other.getRowStride()), colStride(other.getColStride()) {}
+
+    // Accessors
+    size_t numRows() const { return rows; }
+    size_t numCols() const { return cols; }
+    size_t getRowStride() const { return rowStride; }
+    size_t getColStride() const { return colStride; }
+    T* data() const { return ptr; }
+
+    // True when rows are packed back to back with unit column stride
+    bool isContiguous() const {
+        return colStride == 1 && (rowStride == cols || rows <= 1);
     }
-    Matrix(size_t rows, size_t cols) : rows(rows), cols(cols) {
-        data.resize(rows, std::vector<double>(cols, 0.0));
+
+    // Sub-views
+    StridedView row(size_t i) const {
+        if (i >= rows) {
+            throw std::out_of_range("View row index out of range");
+        }
+        return StridedView(ptr + i * rowStride, 1, cols, rowStride, colStride);
     }
-    Matrix(const std::vector<std::vector<double>>& values) {
-        data = values;
-        rows = values.size();
-        cols = values.empty() ? 0 : values[0].size();
+    StridedView col(size_t j) const {
+        if (j >= cols) {
+            throw std::out_of_range("View column index out of range");
+        }
+        return StridedView(ptr + j * colStride, rows, 1, rowStride, colStride);
     }
-
-    // Accessors
-    size_t numRows() const {
-        return rows;
+    StridedView block(size_t row, size_t col, size_t numRows, size_t numCols) const {
+        if (row + numRows > rows || col + numCols > cols) {
+            throw std::out_of_range("View block out of range");
+        }
+        return StridedView(ptr + row * rowStride + col * colStride,
+                           numRows, numCols, rowStride, colStride);
+    }
+    StridedView transposed() const {
+        return StridedView(ptr, cols, rows, colStride, rowStride);
     }
 
-    size_t numCols() const {
-        return cols;
+    // Operator overloads
+    T& operator()(size_t row, size_t col) const {
+        if (row >= rows || col >= cols) {
+            throw std::out_of_range("View index out of range");
+        }
+        return ptr[row * rowStride + col * colStride];
     }
 
-    // Matrix methods
-    Matrix transpose() const {
-        Matrix result(cols, rows);
+    // Copy another view of the same shape into this one, converting the
+    // scalar type if they differ
+    template <typename U>
+    const StridedView& assign(const StridedView<U>& other) const {
+        static_assert(!std::is_const_v<T>, "Cannot assign through a read-only view");
+        if (rows != other.numRows() || cols != other.numCols()) {
+            throw std::invalid_argument(
+                "View dimensions must match for assignment"
+            );
+        }
         for (size_t i = 0; i < rows; ++i) {
             for (size_t j = 0; j < cols; ++j) {
-                result(j, i) = data[i][j];
+                ptr[i * rowStride + j * colStride] = static_cast<Scalar>(
+                    other.data()[i * other.getRowStride() + j * other.getColStride()]
+                );
             }
         }
-        return result;
+        return *this;
     }
-    
-    Matrix hadamard(const Matrix& other) const {
-        if (rows != other.rows || cols != other.cols) {
-            throw std::invalid_argument(
-                "Matrix dimensions must match for Hadamard product"
-            );
-        }
-        Matrix result(rows, cols);
-        
+
+    // In-place updates, mirroring Matrix's, for views into external storage
+    // such as an Arena
+    const StridedView& fill(Scalar value) const {
+        forEach([value](T& v) { v = value; });
+        return *this;
+    }
+
+    template <typename F>
+    const StridedView& applyInPlace(F func) const {
+        forEach([&func](T& v) { v = static_cast<Scalar>(func(v)); });
+        return *this;
+    }
+
+    const StridedView& hadamardInPlace(StridedView<const Scalar> other) const {
+        checkSameShape(other, "Matrix dimensions must match for Hadamard product");
         for (size_t i = 0; i < rows; ++i) {
             for (size_t j = 0; j < cols; ++j) {
-                result(i, j) = data[i][j] * other(i, j);
+                ptr[i * rowStride + j * colStride] *=
+                    other.data()[i * other.getRowStride() + j * other.getColStride()];
             }
         }
-        return result;
+        return *this;
     }
-    
-    Matrix apply(double (*func)(double)) const {
-        Matrix result(rows, cols);
+
+    // this += alpha * x
+    const StridedView& axpy(Scalar alpha, StridedView<const Scalar> x) const {
+        checkSameShape(x, "ERROR: Matrix dimensions do not match for axpy.");
+        if (isContiguous() && x.isContiguous()) {
+            linalg::axpy(rows * cols, alpha, x.data(), ptr);
+            return *this;
+        }
         for (size_t i = 0; i < rows; ++i) {
             for (size_t j = 0; j < cols; ++j) {
-                result(i, j) = func(data[i][j]);
+                ptr[i * rowStride + j * colStride] +=
+                    alpha * x.data()[i * x.getRowStride() + j * x.getColStride()];
             }
         }
-        return result;
+        return *this;
     }
-    // Utility
-    void randomize(double min = -1.0, double max = 1.0) {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        std::uniform_real_distribution<double> dis(min, max);
-        
+
+private:
+    template <typename F>
+    void forEach(F func) const {
+        static_assert(!std::is_const_v<T>, "Cannot modify through a read-only view");
         for (size_t i = 0; i < rows; ++i) {
             for (size_t j = 0; j < cols; ++j) {
-                data[i][j] = dis(gen);
+                func(ptr[i * rowStride + j * colStride]);
             }
         }
     }
-    
-    std::vector<double> toVector() const {
-        if (cols != 1) {
-            throw std::invalid_argument(
-                "Can only convert single-column matrix to vector"
-            );
+
+    template <typename V>
+    void checkSameShape(const V& other, const char* error) const {
+        if (rows != other.numRows() || cols != other.numCols()) {
+            throw std::invalid_argument(error);
         }
-        std::vector<double> result(rows);
-        for (size_t i = 0; i < rows; ++i) {
-            result[i] = data[i][0];
+    }
+};
+
+using MatrixView = StridedView<double>;
+using ConstMatrixView = StridedView<const double>;
+
+// ---------------------------------------------------------------------------
+// Expression templates
+//
+// Arithmetic on matrices builds a small expression tree instead of
+// evaluating eagerly. Nothing is computed until the tree is assigned to a
+// Matrix, at which point all elementwise nodes run in one fused loop, so
+// `W - g * lr` is a single pass over W with no temporaries. Matrix products
+// can't be evaluated elementwise: they go through linalg::gemm straight into
+// the destination, and any elementwise work above them (bias add, activation,
+// scaling) is applied as an epilogue in one pass over the result.
+//
+// Expressions hold references to their Matrix operands, so assign them to a
+// Matrix within the same statement rather than keeping them in an `auto`.
+//
+// Large elementwise passes are split across the shared ThreadPool, so
+// functions given to apply() may run concurrently and must not keep state.
+// ---------------------------------------------------------------------------
+
+template <typename T> class BasicMatrix;
+template <typename T> class ProductExpr;
+
+template <typename Derived> class MatrixExpr;
+template <typename Op, typename L, typename R> class BinaryExpr;
+template <typename F, typename E> class UnaryExpr;
+template <typename E> class ScaledExpr;
+
+// Matrix leaves are held by reference, intermediate nodes by value
+template <typename E> struct ExprStorage { using type = const E; };
+template <typename T> struct ExprStorage<BasicMatrix<T>> { using type = const BasicMatrix<T>&; };
+
+struct AddOp { template <typename T> static T apply(T a, T b) { return a + b; } };
+struct SubOp { template <typename T> static T apply(T a, T b) { return a - b; } };
+struct MulOp { template <typename T> static T apply(T a, T b) { return a * b; } };
+
+// Epilogue applied to every element as it is written out
+struct Identity {
+    template <typename T>
+    T operator()(T v) const { return v; }
+};
+
+// Runs f(lo, hi) over [0, n), split across the shared thread pool once n
+// is large enough to be worth it
+template <typename F>
+inline void forEachRange(size_t n, F&& f) {
+    if (n < PARALLEL_ELEMENTWISE_MIN) {
+        f(size_t(0), n);
+        return;
+    }
+    parallelFor(0, n, PARALLEL_ELEMENTWISE_MIN / 4, f);
+}
+
+template <typename T, typename Post>
+inline void applyEpilogue(T* out, size_t n, const Post& post) {
+    if constexpr (!std::is_same_v<Post, Identity>) {
+        forEachRange(n, [&](size_t lo, size_t hi) {
+            for (size_t k = lo; k < hi; ++k) {
+                out[k] = post(out[k]);
+            }
+        });
+    }
+}
+
+// True when [begin, end) overlaps the memory a view can read
+template <typename T>
+inline bool viewAliases(StridedView<const T> view, const T* begin, const T* end) {
+    if (view.numRows() == 0 || view.numCols() == 0) return false;
+    const T* first = view.data();
+    const T* last = first + (view.numRows() - 1) * view.getRowStride()
+                          + (view.numCols() - 1) * view.getColStride();
+    return first < end && last >= begin;
+}
+
+// CRTP base for everything that can appear on the right of `Matrix =`.
+// Nodes provide a Scalar type, numRows(), numCols(), aliases(),
+// evalTo(out, post) and, when needsEval is false, an elementwise coeff(k)
+// over the row-major layout. Both sides of a binary node share one Scalar.
+template <typename Derived>
+class MatrixExpr {
+public:
+    const Derived& derived() const {
+        return static_cast<const Derived&>(*this);
+    }
+
+    template <typename E>
+    BinaryExpr<MulOp, Derived, E> hadamard(const MatrixExpr<E>& other) const {
+        return BinaryExpr<MulOp, Derived, E>(
+            derived(), other.derived(), "Matrix dimensions must match for Hadamard product"
+        );
+    }
+
+    template <typename F>
+    UnaryExpr<F, Derived> apply(F func) const {
+        return UnaryExpr<F, Derived>(derived(), func);
+    }
+};
+
+template <typename Op, typename L, typename R>
+class BinaryExpr : public MatrixExpr<BinaryExpr<Op, L, R>> {
+private:
+    typename ExprStorage<L>::type lhs;
+    typename ExprStorage<R>::type rhs;
+
+public:
+    using Scalar = typename L::Scalar;
+    static_assert(std::is_same_v<Scalar, typename R::Scalar>,
+                  "Matrix expressions cannot mix scalar types");
+    static constexpr bool needsEval = L::needsEval || R::needsEval;
+
+    BinaryExpr(const L& lhs, const R& rhs, const char* error) : lhs(lhs), rhs(rhs) {
+        if (lhs.numRows() != rhs.numRows() || lhs.numCols() != rhs.numCols()) {
+            throw std::invalid_argument(error);
         }
-        return result;
     }
 
-    // Operator overloads
-    double& operator()(size_t row, size_t col) {
-        if (row >= rows || col >= cols || row < 0 || col < 0) {
-            throw std::out_of_range("Matrix index out of range");
+    size_t numRows() const { return lhs.numRows(); }
+    size_t numCols() const { return lhs.numCols(); }
+    Scalar coeff(size_t k) const { return Op::apply(lhs.coeff(k), rhs.coeff(k)); }
+    bool aliases(const Scalar* begin, const Scalar* end) const {
+        return lhs.aliases(begin, end) || rhs.aliases(begin, end);
+    }
+
+    template <typename Post>
+    void evalTo(Scalar* out, const Post& post) const {
+        const size_t n = numRows() * numCols();
+        if constexpr (!L::needsEval && !R::needsEval) {
+            forEachRange(n, [&](size_t lo, size_t hi) {
+                for (size_t k = lo; k < hi; ++k) {
+                    out[k] = post(Op::apply(lhs.coeff(k), rhs.coeff(k)));
+                }
+            });
+        } else if constexpr (!R::needsEval) {
+            lhs.evalTo(out, Identity());
+            forEachRange(n, [&](size_t lo, size_t hi) {
+                for (size_t k = lo; k < hi; ++k) {
+                    out[k] = post(Op::apply(out[k], rhs.coeff(k)));
+                }
+            });
+        } else if constexpr (!L::needsEval) {
+            rhs.evalTo(out, Identity());
+            forEachRange(n, [&](size_t lo, size_t hi) {
+                for (size_t k = lo; k < hi; ++k) {
+                    out[k] = post(Op::apply(lhs.coeff(k), out[k]));
+                }
+            });
+        } else {
+            // Two products: the second one needs somewhere to live
+            std::vector<Scalar, AlignedAllocator<Scalar>> tmp(n);
+            lhs.evalTo(out, Identity());
+            rhs.evalTo(tmp.data(), Identity());
+            forEachRange(n, [&](size_t lo, size_t hi) {
+                for (size_t k = lo; k < hi; ++k) {
+                    out[k] = post(Op::apply(out[k], tmp[k]));
+                }
+            });
         }
-        return data[row][col];
     }
-    const double& operator()(size_t row, size_t col) const {
-        if (row >= rows || col >= cols || row < 0 || col < 0) {
-            throw std::out_of_range("Matrix index out of range");
+};
+
+template <typename F, typename E>
+class UnaryExpr : public MatrixExpr<UnaryExpr<F, E>> {
+private:
+    typename ExprStorage<E>::type expr;
+    F func;
+
+public:
+    using Scalar = typename E::Scalar;
+    static constexpr bool needsEval = E::needsEval;
+
+    UnaryExpr(const E& expr, F func) : expr(expr), func(func) {}
+
+    size_t numRows() const { return expr.numRows(); }
+    size_t numCols() const { return expr.numCols(); }
+    Scalar coeff(size_t k) const { return static_cast<Scalar>(func(expr.coeff(k))); }
+    bool aliases(const Scalar* begin, const Scalar* end) const {
+        return expr.aliases(begin, end);
+    }
+
+    template <typename Post>
+    void evalTo(Scalar* out, const Post& post) const {
+        if constexpr (!E::needsEval) {
+            const size_t n = numRows() * numCols();
+            forEachRange(n, [&](size_t lo, size_t hi) {
+                for (size_t k = lo; k < hi; ++k) {
+                    out[k] = post(static_cast<Scalar>(func(expr.coeff(k))));
+                }
+            });
+        } else {
+            // Fold the function into the child's epilogue
+            const F& f = func;
+            expr.evalTo(out, [&f, &post](Scalar v) { return post(static_cast<Scalar>(f(v))); });
         }
-        return data[row][col];
     }
-    Matrix operator+(const Matrix& other) const {
-        if (rows != other.rows || cols != other.cols) {
-            throw std::invalid_argument(
-                "ERROR: Matrix dimensions do not match for addition."
-            );
+};
+
+template <typename E>
+class ScaledExpr : public MatrixExpr<ScaledExpr<E>> {
+public:
+    using Scalar = typename E::Scalar;
+
+private:
+    typename ExprStorage<E>::type expr;
+    Scalar scalar;
+
+public:
+    static constexpr bool needsEval = E::needsEval;
+
+    ScaledExpr(const E& expr, Scalar scalar) : expr(expr), scalar(scalar) {}
+
+    size_t numRows() const { return expr.numRows(); }
+    size_t numCols() const { return expr.numCols(); }
+    Scalar coeff(size_t k) const { return expr.coeff(k) * scalar; }
+    bool aliases(const Scalar* begin, const Scalar* end) const {
+        return expr.aliases(begin, end);
+    }
+
+    template <typename Post>
+    void evalTo(Scalar* out, const Post& post) const {
+        if constexpr (!E::needsEval) {
+            const size_t n = numRows() * numCols();
+            forEachRange(n, [&](size_t lo, size_t hi) {
+                for (size_t k = lo; k < hi; ++k) {
+                    out[k] = post(expr.coeff(k) * scalar);
+                }
+            });
+        } else {
+            const Scalar s = scalar;
+            expr.evalTo(out, [s, &post](Scalar v) { return post(v * s); });
         }
-        Matrix result(rows, cols);
+    }
+};
+
+
+// Dense row-major matrix over a floating-point scalar type. Code uses the
+// Matrix (double) and MatrixF (float) aliases below.
+template <typename T>
+class BasicMatrix : public MatrixExpr<BasicMatrix<T>> {
+    static_assert(std::is_floating_point_v<T>, "Matrix scalar type must be floating point");
+
+private:
+    // Row-major: element (i, j) is buffer[i * cols + j]
+    MatrixStorage<T> buffer;
+    size_t rows;
+    size_t cols;
+
+    template <typename U> friend class BasicMatrix;
+
+public:
+    using Scalar = T;
+    using View = StridedView<T>;
+    using ConstView = StridedView<const T>;
+
+    // Constructors
+    BasicMatrix() : rows(0), cols(0) {}
+    BasicMatrix(size_t rows, size_t cols) : buffer(rows * cols, T(0)), rows(rows), cols(cols) {}
+    BasicMatrix(const std::vector<std::vector<T>>& values) {
+        rows = values.size();
+        cols = values.empty() ? 0 : values[0].size();
+        buffer.resize(rows * cols);
         for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < cols; ++j) {
-                result(i, j) = data[i][j] + other(i, j);
+            if (values[i].size() != cols) {
+                throw std::invalid_argument(
+                    "All rows must have the same number of columns"
+                );
             }
+            std::copy(values[i].begin(), values[i].end(), buffer.begin() + i * cols);
         }
-        return result;
     }
-    Matrix operator-(const Matrix& other) const {
-        if (rows != other.rows || cols != other.cols) {
-            throw std::invalid_argument(
-                "ERROR: Matrix dimensions do not match for addition."
-            );
+    explicit BasicMatrix(ConstView view) : buffer(view.numRows() * view.numCols()),
+    rows(view.numRows()), cols(view.numCols()) {
+        this->view().assign(view);
+    }
+    // Convert from another scalar type
+    template <typename U, typename = std::enable_if_t<!std::is_same_v<U, T>>>
+    explicit BasicMatrix(const BasicMatrix<U>& other)
+    : buffer(other.buffer.begin(), other.buffer.end()), rows(other.rows), cols(other.cols) {}
+    // Evaluate an expression tree
+    template <typename E>
+    BasicMatrix(const MatrixExpr<E>& expr) : buffer(expr.derived().numRows() * expr.derived().numCols()),
+    rows(expr.derived().numRows()), cols(expr.derived().numCols()) {
+        static_assert(std::is_same_v<typename E::Scalar, T>, "Expression scalar type must match the Matrix");
+        expr.derived().evalTo(buffer.data(), Identity());
+    }
+
+    // Matrix over rows * cols values owned by someone else (see
+    // MatrixStorage), e.g. a memory-mapped model file kept open by `owner`
+    static BasicMatrix borrow(T* data, size_t rows, size_t cols, std::shared_ptr<const void> owner) {
+        BasicMatrix matrix;
+        matrix.buffer = MatrixStorage<T>::borrow(data, rows * cols, std::move(owner));
+        matrix.rows = rows;
+        matrix.cols = cols;
+        return matrix;
+    }
+
+    BasicMatrix(const BasicMatrix&) = default;
+    BasicMatrix(BasicMatrix&&) noexcept = default;
+    BasicMatrix& operator=(const BasicMatrix&) = default;
+    BasicMatrix& operator=(BasicMatrix&&) noexcept = default;
+
+    template <typename E>
+    BasicMatrix& operator=(const MatrixExpr<E>& expr) {
+        static_assert(std::is_same_v<typename E::Scalar, T>, "Expression scalar type must match the Matrix");
+        const E& e = expr.derived();
+        // Products write the destination before reading all of their
+        // operands, so evaluate out of place if the destination is one
+        if constexpr (E::needsEval) {
+            if (e.aliases(buffer.data(), buffer.data() + buffer.size())) {
+                BasicMatrix result(e);
+                *this = std::move(result);
+                return *this;
+            }
         }
-        Matrix result(rows, cols);
-        for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < cols; ++j) {
-                result(i, j) = data[i][j] - other(i, j);
+        reshape(e.numRows(), e.numCols());
+        e.evalTo(buffer.data(), Identity());
+        return *this;
+    }
+
+    // Accessors
+    size_t numRows() const {
+        return rows;
+    }
+
+    size_t numCols() const {
+        return cols;
+    }
+
+    size_t size() const {
+        return buffer.size();
+    }
+
+    T* data() {
+        return buffer.data();
+    }
+
+    const T* data() const {
+        return buffer.data();
+    }
+
+    // Resize, reusing the existing allocation when it is large enough
+    void reshape(size_t newRows, size_t newCols) {
+        buffer.resize(newRows * newCols);
+        rows = newRows;
+        cols = newCols;
+    }
+
+    // Copy (and convert) another matrix's values, reusing this allocation
+    template <typename U>
+    BasicMatrix& assignFrom(const BasicMatrix<U>& other) {
+        reshape(other.rows, other.cols);
+        std::copy(other.buffer.begin(), other.buffer.end(), buffer.begin());
+        return *this;
+    }
+
+    template <typename U>
+    BasicMatrix<U> cast() const {
+        return BasicMatrix<U>().assignFrom(*this);
+    }
+
+    // Expression leaf interface
+    static constexpr bool needsEval = false;
+    T coeff(size_t k) const {
+        return buffer[k];
+    }
+    bool aliases(const T* begin, const T* end) const {
+        return buffer.data() < end && buffer.data() + buffer.size() > begin;
+    }
+
+    // Views
+    View view() {
+        return View(buffer.data(), rows, cols, cols, 1);
+    }
+    ConstView view() const {
+        return ConstView(buffer.data(), rows, cols, cols, 1);
+    }
+    View row(size_t i) {
+        return view().row(i);
+    }
+    ConstView row(size_t i) const {
+        return view().row(i);
+    }
+    View col(size_t j) {
+        return view().col(j);
+    }
+    ConstView col(size_t j) const {
+        return view().col(j);
+    }
+    View block(size_t row, size_t col, size_t numRows, size_t numCols) {
+        return view().block(row, col, numRows, numCols);
+    }
+    ConstView block(size_t row, size_t col, size_t numRows, size_t numCols) const {
+        return view().block(row, col, numRows, numCols);
+    }
+    // Transpose without copying: swaps the strides
+    View transposed() {
+        return view().transposed();
+    }
+    ConstView transposed() const {
+        return view().transposed();
+    }
+
+    // Matrix methods
+    BasicMatrix transpose() const {
+        BasicMatrix result(cols, rows);
+        // Tile so both the reads and the strided writes stay in cache
+        const size_t tile = 32;
+        const T* src = buffer.data();
+        T* dst = result.buffer.data();
+        for (size_t ii = 0; ii < rows; ii += tile) {
+            const size_t iEnd = std::min(ii + tile, rows);
+            for (size_t jj = 0; jj < cols; jj += tile) {
+                const size_t jEnd = std::min(jj + tile, cols);
+                for (size_t i = ii; i < iEnd; ++i) {
+                    for (size_t j = jj; j < jEnd; ++j) {
+                        dst[j * rows + i] = src[i * cols + j];
+                    }
+                }
             }
         }
         return result;
     }
-    Matrix operator*(double scalar) const {
-        Matrix result(rows, cols);
-        for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < cols; ++j) {
-                result(i, j) = data[i][j] * scalar;
+
+    // In-place updates. These write straight into this matrix's buffer and
+    // never allocate, so they are safe to use inside training loops.
+    template <typename E>
+    BasicMatrix& operator+=(const MatrixExpr<E>& expr) {
+        return accumulate(expr.derived(), T(1));
+    }
+
+    template <typename E>
+    BasicMatrix& operator-=(const MatrixExpr<E>& expr) {
+        return accumulate(expr.derived(), T(-1));
+    }
+
+    BasicMatrix& operator*=(T scalar) {
+        for (T& value : buffer) {
+            value *= scalar;
+        }
+        return *this;
+    }
+
+    // this += alpha * x
+    BasicMatrix& axpy(T alpha, const BasicMatrix& x) {
+        checkSameShape(x, "ERROR: Matrix dimensions do not match for axpy.");
+        linalg::axpy(buffer.size(), alpha, x.data(), buffer.data());
+        return *this;
+    }
+
+    template <typename E>
+    BasicMatrix& hadamardInPlace(const MatrixExpr<E>& expr) {
+        const E& e = expr.derived();
+        checkSameShape(e, "Matrix dimensions must match for Hadamard product");
+        if constexpr (E::needsEval) {
+            return hadamardInPlace(BasicMatrix(e));
+        } else {
+            forEachRange(buffer.size(), [&](size_t lo, size_t hi) {
+                for (size_t k = lo; k < hi; ++k) {
+                    buffer[k] *= e.coeff(k);
+                }
+            });
+            return *this;
+        }
+    }
+
+    template <typename F>
+    BasicMatrix& applyInPlace(F func) {
+        T* values = buffer.data();
+        forEachRange(buffer.size(), [&](size_t lo, size_t hi) {
+            for (size_t k = lo; k < hi; ++k) {
+                values[k] = static_cast<T>(func(values[k]));
             }
+        });
+        return *this;
+    }
+
+    // Utility
+    // Uniform in [min, max), from the calling thread's stream by default
+    void randomize(T min = T(-1), T max = T(1), Rng& generator = rng::local()) {
+        for (T& value : buffer) {
+            value = static_cast<T>(generator.uniform(min, max));
         }
-        return result;
     }
-    Matrix operator*(const Matrix& other) const {
-        if (cols != other.rows) {
+
+    std::vector<T> toVector() const {
+        if (cols != 1) {
             throw std::invalid_argument(
-                "ERROR: Matrix dimensions do not match for multiplication."
+                "Can only convert single-column matrix to vector"
             );
         }
-        Matrix result(rows, other.cols);
-        
-        for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < other.cols; ++j) {
-                for (size_t k = 0; k < cols; ++k) {
-                    result(i, j) += data[i][k] * other(k, j);
-                }
+        return std::vector<T>(buffer.begin(), buffer.end());
+    }
+
+private:
+    template <typename E>
+    void checkSameShape(const E& other, const char* error) const {
+        if (rows != other.numRows() || cols != other.numCols()) {
+            throw std::invalid_argument(error);
+        }
+    }
+
+    // this += sign * expr, with products accumulated by gemm (beta = 1)
+    template <typename E>
+    BasicMatrix& accumulate(const E& e, T sign) {
+        static_assert(std::is_same_v<typename E::Scalar, T>, "Expression scalar type must match the Matrix");
+        checkSameShape(e, sign > 0 ? "ERROR: Matrix dimensions do not match for addition."
+                                   : "ERROR: Matrix dimensions do not match for subtraction.");
+        if constexpr (std::is_same_v<E, ProductExpr<T>>) {
+            if (!e.aliases(buffer.data(), buffer.data() + buffer.size())) {
+                e.gemmInto(buffer.data(), sign, T(1));
+                return *this;
             }
         }
-        return result;
+        if constexpr (E::needsEval) {
+            BasicMatrix value(e);
+            linalg::axpy(buffer.size(), sign, value.data(), buffer.data());
+        } else {
+            forEachRange(buffer.size(), [&](size_t lo, size_t hi) {
+                for (size_t k = lo; k < hi; ++k) {
+                    buffer[k] += sign * e.coeff(k);
+                }
+            });
+        }
+        return *this;
+    }
+
+public:
+    // Operator overloads
+    T& operator()(size_t row, size_t col) {
+        if (row >= rows || col >= cols) {
+            throw std::out_of_range("Matrix index out of range");
+        }
+        return buffer[row * cols + col];
+    }
+    const T& operator()(size_t row, size_t col) const {
+        if (row >= rows || col >= cols) {
+            throw std::out_of_range("Matrix index out of range");
+        }
+        return buffer[row * cols + col];
     }
-    
-    friend std::ostream& operator<<(std::ostream& os, const Matrix& matrix) {
+
+    friend std::ostream& operator<<(std::ostream& os, const BasicMatrix& matrix) {
         if (matrix.numRows() == 0 && matrix.numCols() == 0) {
             os << "{Empty Matrix}" << std::endl;
             goto end;
@@ -182,7 +721,7 @@ public:
         for (int i = 0; i < matrix.rows; ++i) {
             os << "[";
             for (int j = 0; j < matrix.cols; ++j) {
-                os << std::fixed << std::setprecision(4) << matrix.data[i][j];
+                os << std::fixed << std::setprecision(4) << matrix.buffer[i * matrix.cols + j];
                 if (j < matrix.cols - 1) os << ", ";
             }
             os << "]\n";
@@ -193,4 +732,163 @@ public:
 
 };
 
+using Matrix = BasicMatrix<double>;
+using MatrixF = BasicMatrix<float>;
+
+// Matrix product node. Operands are strided views so transposed views feed
+// gemm directly; operands that are themselves expressions are evaluated once
+// up front and kept alive by the node.
+template <typename T>
+class ProductExpr : public MatrixExpr<ProductExpr<T>> {
+private:
+    StridedView<const T> lhs;
+    StridedView<const T> rhs;
+    std::shared_ptr<const BasicMatrix<T>> lhsOwned;
+    std::shared_ptr<const BasicMatrix<T>> rhsOwned;
+
+public:
+    using Scalar = T;
+    static constexpr bool needsEval = true;
+
+    ProductExpr(StridedView<const T> lhs, StridedView<const T> rhs,
+                std::shared_ptr<const BasicMatrix<T>> lhsOwned = nullptr,
+                std::shared_ptr<const BasicMatrix<T>> rhsOwned = nullptr)
+    : lhs(lhs), rhs(rhs), lhsOwned(std::move(lhsOwned)), rhsOwned(std::move(rhsOwned)) {
+        if (lhs.numCols() != rhs.numRows()) {
+            throw std::invalid_argument(
+                "ERROR: Matrix dimensions do not match for multiplication."
+            );
+        }
+    }
+
+    size_t numRows() const { return lhs.numRows(); }
+    size_t numCols() const { return rhs.numCols(); }
+    bool aliases(const T* begin, const T* end) const {
+        return viewAliases(lhs, begin, end) || viewAliases(rhs, begin, end);
+    }
+
+    // out = alpha * lhs * rhs + beta * out
+    void gemmInto(T* out, T alpha, T beta) const {
+        linalg::gemm(numRows(), numCols(), lhs.numCols(), alpha,
+                      lhs.data(), lhs.getRowStride(), lhs.getColStride(),
+                      rhs.data(), rhs.getRowStride(), rhs.getColStride(),
+                      beta, out, numCols());
+    }
+
+    template <typename Post>
+    void evalTo(T* out, const Post& post) const {
+        gemmInto(out, T(1), T(0));
+        applyEpilogue(out, numRows() * numCols(), post);
+    }
+};
+
+// BLAS-style C = alpha * op(A) * op(B) + beta * C, where op() optionally
+// transposes its operand through a strided view. C must be a row-major view
+// (unit column stride) and must not overlap A or B.
+template <typename T>
+inline void gemm(StridedView<T> C,
+                 std::type_identity_t<StridedView<const T>> A,
+                 std::type_identity_t<StridedView<const T>> B,
+                 std::type_identity_t<T> alpha = T(1), std::type_identity_t<T> beta = T(0),
+                 bool transA = false, bool transB = false) {
+    if (transA) A = A.transposed();
+    if (transB) B = B.transposed();
+    if (A.numCols() != B.numRows() || C.numRows() != A.numRows() || C.numCols() != B.numCols()) {
+        throw std::invalid_argument(
+            "ERROR: Matrix dimensions do not match for gemm."
+        );
+    }
+    if (C.getColStride() != 1) {
+        throw std::invalid_argument("gemm output must have unit column stride");
+    }
+    linalg::gemm(A.numRows(), B.numCols(), A.numCols(), alpha,
+                  A.data(), A.getRowStride(), A.getColStride(),
+                  B.data(), B.getRowStride(), B.getColStride(),
+                  beta, C.data(), C.getRowStride());
+}
+
+// Matrix overload: when beta is zero C is resized to fit, reusing its
+// existing allocation whenever it is large enough.
+template <typename T>
+inline void gemm(BasicMatrix<T>& C, const BasicMatrix<T>& A, const BasicMatrix<T>& B,
+                 std::type_identity_t<T> alpha = T(1), std::type_identity_t<T> beta = T(0),
+                 bool transA = false, bool transB = false) {
+    if (beta == T(0)) {
+        C.reshape(transA ? A.numCols() : A.numRows(), transB ? B.numRows() : B.numCols());
+    }
+    gemm<T>(C.view(), A.view(), B.view(), alpha, beta, transA, transB);
+}
+
+template <typename E, typename T = typename E::Scalar>
+inline StridedView<const T> productOperand(const MatrixExpr<E>& expr,
+                                           std::shared_ptr<const BasicMatrix<T>>& owned) {
+    if constexpr (std::is_same_v<E, BasicMatrix<T>>) {
+        return expr.derived().view();
+    } else {
+        owned = std::make_shared<const BasicMatrix<T>>(expr.derived());
+        return owned->view();
+    }
+}
+
+// Operator overloads
+template <typename L, typename R>
+inline BinaryExpr<AddOp, L, R> operator+(const MatrixExpr<L>& lhs, const MatrixExpr<R>& rhs) {
+    return BinaryExpr<AddOp, L, R>(
+        lhs.derived(), rhs.derived(), "ERROR: Matrix dimensions do not match for addition."
+    );
+}
+
+template <typename L, typename R>
+inline BinaryExpr<SubOp, L, R> operator-(const MatrixExpr<L>& lhs, const MatrixExpr<R>& rhs) {
+    return BinaryExpr<SubOp, L, R>(
+        lhs.derived(), rhs.derived(), "ERROR: Matrix dimensions do not match for subtraction."
+    );
+}
+
+template <typename E>
+inline ScaledExpr<E> operator*(const MatrixExpr<E>& expr, typename E::Scalar scalar) {
+    return ScaledExpr<E>(expr.derived(), scalar);
+}
+
+template <typename E>
+inline ScaledExpr<E> operator*(typename E::Scalar scalar, const MatrixExpr<E>& expr) {
+    return ScaledExpr<E>(expr.derived(), scalar);
+}
+
+template <typename L, typename R>
+inline ProductExpr<typename L::Scalar> operator*(const MatrixExpr<L>& lhs, const MatrixExpr<R>& rhs) {
+    using T = typename L::Scalar;
+    static_assert(std::is_same_v<T, typename R::Scalar>, "Matrix products cannot mix scalar types");
+    std::shared_ptr<const BasicMatrix<T>> lhsOwned, rhsOwned;
+    StridedView<const T> l = productOperand(lhs, lhsOwned);
+    StridedView<const T> r = productOperand(rhs, rhsOwned);
+    return ProductExpr<T>(l, r, std::move(lhsOwned), std::move(rhsOwned));
+}
+
+template <typename V, typename R>
+inline ProductExpr<typename R::Scalar> operator*(StridedView<V> lhs, const MatrixExpr<R>& rhs) {
+    using T = typename R::Scalar;
+    std::shared_ptr<const BasicMatrix<T>> rhsOwned;
+    StridedView<const T> r = productOperand(rhs, rhsOwned);
+    return ProductExpr<T>(lhs, r, nullptr, std::move(rhsOwned));
+}
+
+template <typename L, typename V>
+inline ProductExpr<typename L::Scalar> operator*(const MatrixExpr<L>& lhs, StridedView<V> rhs) {
+    using T = typename L::Scalar;
+    std::shared_ptr<const BasicMatrix<T>> lhsOwned;
+    StridedView<const T> l = productOperand(lhs, lhsOwned);
+    return ProductExpr<T>(l, rhs, std::move(lhsOwned));
+}
+
+template <typename V, typename W>
+inline ProductExpr<std::remove_const_t<V>> operator*(StridedView<V> lhs, StridedView<W> rhs) {
+    return ProductExpr<std::remove_const_t<V>>(lhs, rhs);
+}
+
+template <typename E, typename = std::enable_if_t<!std::is_same_v<E, BasicMatrix<typename E::Scalar>>>>
+inline std::ostream& operator<<(std::ostream& os, const MatrixExpr<E>& expr) {
+    return os << BasicMatrix<typename E::Scalar>(expr);
+}
+
 #endif /* matrix_hpp */
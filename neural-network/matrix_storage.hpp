@@ -0,0 +1,107 @@
+//
+//  matrix_storage.hpp
+//  neural-network
+//
+
+#ifndef matrix_storage_hpp
+#define matrix_storage_hpp
+
+#include "aligned_allocator.hpp"
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+
+// Element buffer behind a Matrix. Normally it owns a cache-line aligned
+// allocation, but it can also borrow memory that lives elsewhere (a
+// memory-mapped model file) so a loaded network uses the file's pages
+// directly. A borrowed buffer keeps its owner alive through `keepAlive`
+// and is written in place. Copies are always owned, and resizing a
+// borrowed buffer moves it into an owned one.
+template <typename T>
+class MatrixStorage {
+private:
+    std::vector<T, AlignedAllocator<T>> owned;
+    T* values = nullptr;
+    size_t count = 0;
+    std::shared_ptr<const void> keepAlive;
+
+    void adoptOwned() {
+        values = owned.data();
+        count = owned.size();
+        keepAlive.reset();
+    }
+
+public:
+    MatrixStorage() = default;
+    explicit MatrixStorage(size_t n, T value = T(0)) : owned(n, value) {
+        adoptOwned();
+    }
+    template <typename It>
+    MatrixStorage(It first, It last) : owned(first, last) {
+        adoptOwned();
+    }
+
+    // Wraps n values at `data` without copying them
+    static MatrixStorage borrow(T* data, size_t n, std::shared_ptr<const void> owner) {
+        MatrixStorage storage;
+        storage.values = data;
+        storage.count = n;
+        storage.keepAlive = std::move(owner);
+        return storage;
+    }
+
+    MatrixStorage(const MatrixStorage& other) : owned(other.begin(), other.end()) {
+        adoptOwned();
+    }
+    MatrixStorage(MatrixStorage&& other) noexcept
+    : owned(std::move(other.owned)), values(other.values), count(other.count),
+    keepAlive(std::move(other.keepAlive)) {
+        other.values = nullptr;
+        other.count = 0;
+    }
+    MatrixStorage& operator=(const MatrixStorage& other) {
+        if (this == &other) return *this;
+        if (count == other.count) {
+            std::copy(other.begin(), other.end(), values);
+        } else {
+            owned.assign(other.begin(), other.end());
+            adoptOwned();
+        }
+        return *this;
+    }
+    MatrixStorage& operator=(MatrixStorage&& other) noexcept {
+        owned = std::move(other.owned);
+        values = other.values;
+        count = other.count;
+        keepAlive = std::move(other.keepAlive);
+        other.values = nullptr;
+        other.count = 0;
+        return *this;
+    }
+
+    void resize(size_t n) {
+        if (n == count) return;
+        if (isBorrowed()) {
+            owned.assign(values, values + std::min(n, count));
+        }
+        owned.resize(n);
+        adoptOwned();
+    }
+
+    bool isBorrowed() const {
+        return values != nullptr && values != owned.data();
+    }
+
+    size_t size() const { return count; }
+    T* data() { return values; }
+    const T* data() const { return values; }
+    T* begin() { return values; }
+    T* end() { return values + count; }
+    const T* begin() const { return values; }
+    const T* end() const { return values + count; }
+    T& operator[](size_t k) { return values[k]; }
+    const T& operator[](size_t k) const { return values[k]; }
+};
+
+#endif /* matrix_storage_hpp */
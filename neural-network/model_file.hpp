@@ -0,0 +1,300 @@
+//
+//  model_file.hpp
+//  neural-network
+//
+//  Binary model format, built to be memory-mapped. A file is
+//
+//      Header
+//      uint64 layer sizes[layerCount]
+//      uint32 activations[layerCount - 1]
+//      padding to 64 bytes
+//      per weight layer: weights (rows x cols, row-major), then biases,
+//      each starting on a 64 byte boundary
+//      padding to 64 bytes
+//
+//  Values are stored in the native byte order of the machine that wrote
+//  the file, as the scalar type recorded in the header. The header's
+//  endianness tag lets a reader with the other byte order reject the file
+//  instead of misreading it. The checksum is a word-wise FNV-1a hash of
+//  everything after the header.
+//
+//  open() maps the file copy-on-write and hands out pointers straight into
+//  the mapping, so a network can be built on the file's pages without
+//  copying or parsing them. Training such a network only copies the pages
+//  it writes, and never changes the file.
+//
+
+#ifndef model_file_hpp
+#define model_file_hpp
+
+#include "activation.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace model {
+
+constexpr char MAGIC[8] = {'N', 'N', 'M', 'O', 'D', 'E', 'L', '\0'};
+constexpr uint32_t VERSION = 1;
+// Reads back as 0x04030201 on a machine with the other byte order
+constexpr uint32_t ENDIAN_TAG = 0x01020304;
+constexpr size_t ALIGNMENT = 64;
+
+enum class ScalarType : uint32_t { Float64 = 0, Float32 = 1 };
+
+template <typename T>
+constexpr ScalarType scalarTypeOf() {
+    static_assert(std::is_same_v<T, double> || std::is_same_v<T, float>, "Models store double or float");
+    return std::is_same_v<T, double> ? ScalarType::Float64 : ScalarType::Float32;
+}
+
+inline size_t scalarSize(ScalarType type) {
+    return type == ScalarType::Float64 ? sizeof(double) : sizeof(float);
+}
+
+struct Header {
+    char magic[8];
+    uint32_t endianTag;
+    uint32_t version;
+    uint32_t scalarType;
+    uint32_t layerCount;
+    double learningRate;
+    uint64_t fileSize;
+    uint64_t checksum;
+};
+static_assert(sizeof(Header) == 48, "Header layout must not depend on the compiler");
+
+inline uint64_t alignUp(uint64_t offset) {
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// FNV-1a over 8-byte words; n must be a multiple of 8
+inline uint64_t checksum(const unsigned char* data, size_t n) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t k = 0; k < n; k += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + k, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Byte offsets of every blob for a given architecture and scalar type
+struct Layout {
+    std::vector<uint64_t> weightOffsets;
+    std::vector<uint64_t> biasOffsets;
+    uint64_t fileSize = 0;
+
+    Layout() = default;
+    Layout(const std::vector<size_t>& layers, ScalarType type) {
+        const size_t scalar = scalarSize(type);
+        uint64_t offset = sizeof(Header) + layers.size() * sizeof(uint64_t)
+                        + (layers.size() - 1) * sizeof(uint32_t);
+        for (size_t i = 0; i + 1 < layers.size(); ++i) {
+            offset = alignUp(offset);
+            weightOffsets.push_back(offset);
+            offset += layers[i + 1] * layers[i] * scalar;
+            offset = alignUp(offset);
+            biasOffsets.push_back(offset);
+            offset += layers[i + 1] * scalar;
+        }
+        fileSize = alignUp(offset);
+    }
+};
+
+// Writes a model whose layer i weights and biases are weights[i] and
+// biases[i], each holding layers[i + 1] x layers[i] (resp. layers[i + 1])
+// values of type T
+template <typename T>
+inline void write(const std::string& path, double learningRate,
+                  const std::vector<size_t>& layers, const std::vector<Activation>& activations,
+                  const std::vector<const T*>& weights, const std::vector<const T*>& biases) {
+    const ScalarType type = scalarTypeOf<T>();
+    const Layout layout(layers, type);
+    std::vector<unsigned char> bytes(layout.fileSize, 0);
+
+    unsigned char* table = bytes.data() + sizeof(Header);
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const uint64_t size = layers[i];
+        std::memcpy(table + i * sizeof(uint64_t), &size, sizeof(size));
+    }
+    table += layers.size() * sizeof(uint64_t);
+    for (size_t i = 0; i < activations.size(); ++i) {
+        const uint32_t f = static_cast<uint32_t>(activations[i]);
+        std::memcpy(table + i * sizeof(uint32_t), &f, sizeof(f));
+    }
+    for (size_t i = 0; i + 1 < layers.size(); ++i) {
+        std::memcpy(bytes.data() + layout.weightOffsets[i], weights[i], layers[i + 1] * layers[i] * sizeof(T));
+        std::memcpy(bytes.data() + layout.biasOffsets[i], biases[i], layers[i + 1] * sizeof(T));
+    }
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.endianTag = ENDIAN_TAG;
+    header.version = VERSION;
+    header.scalarType = static_cast<uint32_t>(type);
+    header.layerCount = static_cast<uint32_t>(layers.size());
+    header.learningRate = learningRate;
+    header.fileSize = layout.fileSize;
+    header.checksum = checksum(bytes.data() + sizeof(Header), bytes.size() - sizeof(Header));
+    std::memcpy(bytes.data(), &header, sizeof(header));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!file) {
+        throw std::runtime_error("Could not write model file " + path);
+    }
+}
+
+// A private, copy-on-write mapping of a whole file
+class Mapping {
+private:
+    void* base;
+    size_t length;
+
+public:
+    explicit Mapping(const std::string& path) : base(nullptr), length(0) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open model file " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+            ::close(fd);
+            throw std::runtime_error("Model file " + path + " is too short");
+        }
+        length = static_cast<size_t>(info.st_size);
+        base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error("Could not map model file " + path);
+        }
+    }
+    ~Mapping() {
+        ::munmap(base, length);
+    }
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    unsigned char* data() const { return static_cast<unsigned char*>(base); }
+    size_t size() const { return length; }
+};
+
+// A validated, mapped model file
+struct File {
+    std::shared_ptr<Mapping> mapping;
+    Header header;
+    std::vector<size_t> layers;
+    std::vector<Activation> activations;
+    Layout layout;
+
+    ScalarType scalarType() const {
+        return static_cast<ScalarType>(header.scalarType);
+    }
+
+    // Weights and biases of layer i, in the file's scalar type T
+    template <typename T>
+    T* weights(size_t i) const {
+        return reinterpret_cast<T*>(mapping->data() + layout.weightOffsets[i]);
+    }
+    template <typename T>
+    T* biases(size_t i) const {
+        return reinterpret_cast<T*>(mapping->data() + layout.biasOffsets[i]);
+    }
+};
+
+// Maps and validates a model file. Verifying the checksum reads every
+// page of the file; skip it to start up without touching the weights.
+inline File open(const std::string& path, bool verify = true) {
+    File file;
+    file.mapping = std::make_shared<Mapping>(path);
+    const unsigned char* bytes = file.mapping->data();
+    std::memcpy(&file.header, bytes, sizeof(Header));
+    const Header& header = file.header;
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(path + " is not a model file");
+    }
+    if (header.endianTag != ENDIAN_TAG) {
+        throw std::runtime_error(path + " was written on a machine with a different byte order");
+    }
+    if (header.version != VERSION) {
+        throw std::runtime_error(path + " has unsupported model format version " + std::to_string(header.version));
+    }
+    if (header.scalarType > static_cast<uint32_t>(ScalarType::Float32)) {
+        throw std::runtime_error(path + " has an unknown scalar type");
+    }
+    if (header.layerCount < 2 || header.fileSize != file.mapping->size()) {
+        throw std::runtime_error(path + " is truncated or corrupt");
+    }
+    const size_t tableBytes = header.layerCount * sizeof(uint64_t) + (header.layerCount - 1) * sizeof(uint32_t);
+    if (sizeof(Header) + tableBytes > header.fileSize) {
+        throw std::runtime_error(path + " is truncated or corrupt");
+    }
+
+    const unsigned char* table = bytes + sizeof(Header);
+    for (size_t i = 0; i < header.layerCount; ++i) {
+        uint64_t size;
+        std::memcpy(&size, table + i * sizeof(uint64_t), sizeof(size));
+        file.layers.push_back(static_cast<size_t>(size));
+    }
+    table += header.layerCount * sizeof(uint64_t);
+    for (size_t i = 0; i + 1 < header.layerCount; ++i) {
+        uint32_t f;
+        std::memcpy(&f, table + i * sizeof(uint32_t), sizeof(f));
+        if (f > static_cast<uint32_t>(Activation::GELU)) {
+            throw std::runtime_error(path + " has an unknown activation function");
+        }
+        file.activations.push_back(static_cast<Activation>(f));
+    }
+
+    // Layer sizes are untrusted: reject empty layers, and walk the blobs
+    // as Layout does, stopping at the first that would run past the file,
+    // before Layout multiplies them out. Every term is at most the file
+    // size, so the running offset can't overflow.
+    const uint64_t limit = header.fileSize;
+    const uint64_t scalar = scalarSize(file.scalarType());
+    uint64_t offset = sizeof(Header) + tableBytes;
+    for (size_t i = 0; i < file.layers.size(); ++i) {
+        if (file.layers[i] == 0) {
+            throw std::runtime_error(path + " has an empty layer");
+        }
+    }
+    for (size_t i = 0; i + 1 < file.layers.size(); ++i) {
+        const uint64_t rows = file.layers[i + 1];
+        const uint64_t cols = file.layers[i];
+        if (cols > limit / rows || rows * cols > limit / scalar) {
+            throw std::runtime_error(path + " is truncated or corrupt");
+        }
+        offset = alignUp(offset) + rows * cols * scalar;
+        if (offset <= limit) {
+            offset = alignUp(offset) + rows * scalar;
+        }
+        if (offset > limit) {
+            throw std::runtime_error(path + " is truncated or corrupt");
+        }
+    }
+
+    file.layout = Layout(file.layers, file.scalarType());
+    if (file.layout.fileSize != header.fileSize) {
+        throw std::runtime_error(path + " is truncated or corrupt");
+    }
+    if (verify && checksum(bytes + sizeof(Header), header.fileSize - sizeof(Header)) != header.checksum) {
+        throw std::runtime_error(path + " failed its checksum");
+    }
+    return file;
+}
+
+} // namespace model
+
+#endif /* model_file_hpp */
@@ -0,0 +1,442 @@
+//
+//  network_base.hpp
+//  neural-network
+//
+
+#ifndef network_base_hpp
+#define network_base_hpp
+
+#include "optimizer.hpp"
+#include "checkpoint.hpp"
+#include "random.hpp"
+#include "dataset.hpp"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <span>
+#include <stdexcept>
+#include <memory>
+
+// Common interface of every network engine (the dynamically sized
+// NeuralNetwork and the fixed-size StaticNeuralNetwork), so a Problem can
+// choose its engine and the visualiser can drive either one.
+class Network {
+public:
+    virtual ~Network() = default;
+
+    virtual std::vector<double> predict(const std::vector<double>& input) const = 0;
+    // Writes the prediction into a caller-owned buffer without allocating;
+    // safe to call concurrently from several threads
+    virtual void predict(std::span<const double> input, std::span<double> output) const = 0;
+    // Predicts many samples at once. Samples are stored one after another:
+    // inputs holds N * inputSize values and outputs receives N * outputSize.
+    virtual void predictBatch(std::span<const double> inputs, std::span<double> outputs) const = 0;
+    std::vector<double> predictBatch(std::span<const double> inputs) const {
+        const std::vector<size_t>& layers = getArchitecture();
+        std::vector<double> outputs(inputs.size() / layers.front() * layers.back());
+        predictBatch(inputs, outputs);
+        return outputs;
+    }
+    virtual void trainSingle(const std::vector<double>& input, const std::vector<double>& target) = 0;
+    // One update with the gradient averaged over a mini-batch: the samples
+    // at indices[0 .. count), or the first `count` samples when indices is
+    // null
+    virtual void trainBatch(const std::vector<std::vector<double>>& inputs,
+                            const std::vector<std::vector<double>>& targets,
+                            const size_t* indices, size_t count) = 0;
+    // Whole data set as a single batch
+    void trainBatch(const std::vector<std::vector<double>>& inputs,
+                    const std::vector<std::vector<double>>& targets) {
+        trainBatch(inputs, targets, nullptr, inputs.size());
+    }
+    // batchSize 1 is per-sample SGD; larger sizes train on mini-batches,
+    // with a smaller final batch when the data doesn't divide evenly
+    virtual void train(const std::vector<std::vector<double>>& inputs,
+                       const std::vector<std::vector<double>>& targets,
+                       int epochs = 1000,
+                       bool shuffle = true,
+                       size_t batchSize = 1) = 0;
+    // The same on contiguous data; a Dataset converts to its view
+    virtual void train(const DatasetView& data, int epochs = 1000, bool shuffle = true, size_t batchSize = 1) = 0;
+    // One update on a contiguous mini-batch, e.g. data.batch(first, n)
+    virtual void trainBatch(const DatasetView& batch) = 0;
+    // One update per mini-batch the source hands out, for `epochs` passes
+    virtual void train(BatchSource& source, int epochs = 1) = 0;
+
+    virtual const std::vector<size_t>& getArchitecture() const = 0;
+    virtual void setLearningRate(double lr) = 0;
+    // Update rule; resets any optimizer state (momentum, moments)
+    virtual void setOptimizer(const Optimizer& optimizer) = 0;
+    // Scales the learning rate by epoch
+    virtual void setSchedule(const Schedule& schedule) = 0;
+    // How train() measures the error it reports. By default it is the mean
+    // squared error of the last epoch's training steps, accumulated from
+    // forward passes they run anyway. With interval > 0, every interval-th
+    // train() call instead evaluates the final weights on `samples` random
+    // samples, or on the whole data set when samples is 0.
+    virtual void setEvaluation(int interval, size_t samples = 0) = 0;
+    // Print the error after each train() call (on by default)
+    virtual void setVerbose(bool verbose) = 0;
+    // Latest and previous errors, each with the epoch it was measured at
+    virtual std::pair<std::pair<int, double>, std::pair<int, double>> getError() = 0;
+    // Copy of everything needed to resume training exactly
+    virtual TrainingState captureState() const = 0;
+    // Resumes from a captured state, which must match this architecture
+    virtual void restoreState(const TrainingState& state) = 0;
+    // Submit a snapshot to `checkpointer` every `interval` epochs (0 = never)
+    virtual void setCheckpointer(std::shared_ptr<Checkpointer> checkpointer, int interval) = 0;
+    // Restarts the stream that shuffles and samples the training data. The
+    // initial weights come from the context (see rng::setSeed).
+    virtual void setSeed(uint64_t seed) = 0;
+    virtual std::string toString() const = 0;
+};
+
+// Training loop and bookkeeping shared by the engines. Derived provides
+// predict and trainSamples(count, input, target), one update on `count`
+// samples where input(b) and target(b) return sample b as a span; engines
+// are final classes, so the calls below are resolved statically rather
+// than through the vtable.
+template <typename Derived>
+class NetworkBase : public Network {
+protected:
+    std::vector<size_t> architecture;
+    double learningRate;
+    int totalEpochs;
+    std::pair<int, double> prev_error;
+    std::pair<int, double> cached_error;
+    Optimizer optimizer;
+    Schedule schedule;
+    long optimizerSteps;
+    // Squared error summed over the current epoch's training samples, and
+    // the mean of the last complete epoch
+    double epochLoss;
+    size_t epochSamples;
+    double trainingError;
+    int evaluationInterval;
+    size_t evaluationSamples;
+    int trainCalls;
+    bool verbose;
+    std::shared_ptr<Checkpointer> checkpointer;
+    int checkpointInterval;
+    // Initialisation, shuffling and evaluation sampling
+    Rng generator;
+
+    NetworkBase(const std::vector<size_t>& layers, double lr)
+    : architecture(layers), learningRate(lr), totalEpochs(0),
+    prev_error(std::make_pair(0, 0.0)), cached_error(std::make_pair(0, 0.0)),
+    optimizerSteps(0), epochLoss(0.0), epochSamples(0), trainingError(0.0),
+    evaluationInterval(0), evaluationSamples(0), trainCalls(0), verbose(true),
+    checkpointInterval(0), generator(rng::stream()) {}
+
+private:
+    Derived& derived() {
+        return static_cast<Derived&>(*this);
+    }
+
+protected:
+    // Learning rate for the current epoch, after the schedule
+    double currentRate() const {
+        return schedule.rate(learningRate, totalEpochs);
+    }
+
+    // Coefficients for the next optimizer update, counting it
+    optim::StepCoefficients nextStep() {
+        return optim::coefficients(optimizer, currentRate(), ++optimizerSteps);
+    }
+
+    // Coefficients shared by the next `count` updates, for updates that run
+    // concurrently and can't each take a step of their own; counts them
+    // all. Adam's bias correction is that of the last of them.
+    optim::StepCoefficients claimSteps(long count) {
+        optimizerSteps += count;
+        return optim::coefficients(optimizer, currentRate(), optimizerSteps);
+    }
+
+    // Number of samples in a predictBatch call, checking the buffer sizes
+    size_t batchCount(std::span<const double> inputs, std::span<double> outputs) const {
+        const size_t count = inputs.size() / architecture.front();
+        if (inputs.size() != count * architecture.front() || outputs.size() != count * architecture.back()) {
+            throw std::invalid_argument("Batch buffers must hold whole samples of the network input and output layers");
+        }
+        return count;
+    }
+
+    // Adds the squared error of `samples` training samples, measured by the
+    // forward pass of their training step, to the current epoch
+    void addLoss(double squaredError, size_t samples) {
+        epochLoss += squaredError;
+        epochSamples += samples;
+    }
+
+    void finishEpoch() {
+        if (epochSamples > 0) {
+            trainingError = epochLoss / static_cast<double>(epochSamples);
+        }
+        epochLoss = 0.0;
+        epochSamples = 0;
+        totalEpochs++;
+    }
+
+    // Submits a snapshot when the epoch just finished is on the checkpoint
+    // interval. Training loops call this after each epoch but the last, and
+    // after recordError() for the last, so its snapshot has the final error.
+    void checkpointIfDue() {
+        if (checkpointer && checkpointInterval > 0 && totalEpochs % checkpointInterval == 0) {
+            checkpointer->submit(derived().captureState());
+        }
+    }
+
+    // The bookkeeping half of captureState(); engines add their buffers
+    TrainingState captureBase() const {
+        TrainingState state;
+        state.architecture = architecture;
+        state.totalEpochs = totalEpochs;
+        state.cachedError = cached_error;
+        state.prevError = prev_error;
+        state.trainingError = trainingError;
+        state.learningRate = learningRate;
+        state.optimizer = optimizer;
+        state.schedule = schedule;
+        state.optimizerSteps = optimizerSteps;
+        state.generator = generator.state();
+        return state;
+    }
+
+    // The bookkeeping half of restoreState(), after checking that `state`
+    // has this architecture and buffers of the given sizes. Nothing is
+    // changed if a check fails, so the engine copies the buffers after.
+    void restoreBase(const TrainingState& state, const std::vector<size_t>& bufferSizes) {
+        if (state.architecture != architecture) {
+            throw std::invalid_argument("Training state is for a different architecture");
+        }
+        if (state.buffers.size() != bufferSizes.size()) {
+            throw std::invalid_argument("Training state does not match this network");
+        }
+        for (size_t k = 0; k < bufferSizes.size(); ++k) {
+            if (state.buffers[k].size() != bufferSizes[k]) {
+                throw std::invalid_argument("Training state does not match this network");
+            }
+        }
+        totalEpochs = state.totalEpochs;
+        cached_error = state.cachedError;
+        prev_error = state.prevError;
+        trainingError = state.trainingError;
+        learningRate = state.learningRate;
+        optimizer = state.optimizer;
+        schedule = state.schedule;
+        optimizerSteps = state.optimizerSteps;
+        generator = Rng(state.generator);
+    }
+
+    // Sample accessors: sample i as a span
+    static auto samplesOf(const std::vector<std::vector<double>>& values) {
+        return [&values](size_t i) { return std::span<const double>(values[i]); };
+    }
+    static auto inputsOf(const DatasetView& data) {
+        return [&data](size_t i) { return data.input(i); };
+    }
+    static auto targetsOf(const DatasetView& data) {
+        return [&data](size_t i) { return data.target(i); };
+    }
+
+    void checkShape(const DatasetView& data) const {
+        if (!data.empty() && (data.inputSize() != architecture.front() || data.outputSize() != architecture.back())) {
+            throw std::invalid_argument("Data set shape must match the network");
+        }
+    }
+
+    // Mean squared error of the current weights on the `size` samples, or
+    // on `samples` samples drawn at random from them
+    template <typename Input, typename Target>
+    double evaluate(size_t size, Input input, Target target, size_t samples) {
+        const size_t count = samples == 0 ? size : samples;
+        std::vector<double> prediction(architecture.back());
+        double totalError = 0.0;
+        for (size_t n = 0; n < count; ++n) {
+            const size_t i = samples == 0 ? n : static_cast<size_t>(generator.below(size));
+            derived().predict(input(i), std::span<double>(prediction));
+            const std::span<const double> expected = target(i);
+            for (size_t j = 0; j < prediction.size(); ++j) {
+                double error = prediction[j] - expected[j];
+                totalError += error * error;
+            }
+        }
+        return totalError / count;
+    }
+
+    // Error at the end of a train() call, kept for getError() and printed
+    template <typename Input, typename Target>
+    void recordError(size_t size, Input input, Target target) {
+        ++trainCalls;
+        double error = trainingError;
+        if (evaluationInterval > 0 && trainCalls % evaluationInterval == 0 && size > 0) {
+            error = evaluate(size, input, target, evaluationSamples);
+        }
+        prev_error = cached_error;
+        cached_error = std::make_pair(totalEpochs, error);
+        if (verbose) {
+            std::cout << "Epoch " << totalEpochs << ", Average Error: " << error << std::endl;
+        }
+    }
+
+    // The training loop over `size` samples, whatever their storage
+    template <typename Input, typename Target>
+    void trainEpochs(size_t size, Input input, Target target, int epochs, bool shuffle, size_t batchSize) {
+        batchSize = std::max<size_t>(batchSize, 1);
+
+        std::vector<size_t> indices(size);
+        std::iota(indices.begin(), indices.end(), 0);
+
+        for (int epoch = 0; epoch < epochs; ++epoch) {
+            if (shuffle) {
+                generator.shuffle(indices.begin(), indices.end());
+            }
+
+            for (size_t start = 0; start < indices.size(); start += batchSize) {
+                const size_t count = std::min(batchSize, indices.size() - start);
+                const size_t* batch = indices.data() + start;
+                derived().trainSamples(count,
+                                       [&](size_t b) { return input(batch[b]); },
+                                       [&](size_t b) { return target(batch[b]); });
+            }
+
+            finishEpoch();
+            if (epoch + 1 < epochs) {
+                checkpointIfDue();
+            }
+        }
+        recordError(size, input, target);
+        checkpointIfDue();
+    }
+
+public:
+    // Train on batch of data
+    void train(const std::vector<std::vector<double>>& inputs,
+               const std::vector<std::vector<double>>& targets,
+               int epochs = 1000,
+               bool shuffle = true,
+               size_t batchSize = 1) override {
+        assert(inputs.size() == targets.size() && "Number of inputs must match number of targets");
+        trainEpochs(inputs.size(), samplesOf(inputs), samplesOf(targets), epochs, shuffle, batchSize);
+    }
+
+    // Samples are read where the data set keeps them
+    void train(const DatasetView& data, int epochs = 1000, bool shuffle = true, size_t batchSize = 1) override {
+        checkShape(data);
+        trainEpochs(data.size(), inputsOf(data), targetsOf(data), epochs, shuffle, batchSize);
+    }
+
+    // The source decides the batches and their order; the error reported
+    // afterwards is the training error of the last epoch
+    void train(BatchSource& source, int epochs = 1) override {
+        if (source.inputSize() != architecture.front() || source.outputSize() != architecture.back()) {
+            throw std::invalid_argument("Data set shape must match the network");
+        }
+        for (int epoch = 0; epoch < epochs; ++epoch) {
+            source.rewind();
+            for (DatasetView batch = source.next(); !batch.empty(); batch = source.next()) {
+                derived().trainSamples(batch.size(), inputsOf(batch), targetsOf(batch));
+            }
+
+            finishEpoch();
+            if (epoch + 1 < epochs) {
+                checkpointIfDue();
+            }
+        }
+        const DatasetView none;
+        recordError(0, inputsOf(none), targetsOf(none));
+        checkpointIfDue();
+    }
+
+    void trainSingle(const std::vector<double>& input, const std::vector<double>& target) override {
+        assert(input.size() == architecture.front() && "Input size must match network input layer");
+        assert(target.size() == architecture.back() && "Target size must match network output layer");
+        derived().trainSamples(1,
+                               [&](size_t) { return std::span<const double>(input); },
+                               [&](size_t) { return std::span<const double>(target); });
+    }
+
+    void trainBatch(const std::vector<std::vector<double>>& inputs,
+                    const std::vector<std::vector<double>>& targets,
+                    const size_t* indices, size_t count) override {
+        assert(inputs.size() == targets.size() && "Number of inputs must match number of targets");
+        derived().trainSamples(count,
+                               [&](size_t b) { return std::span<const double>(inputs[indices ? indices[b] : b]); },
+                               [&](size_t b) { return std::span<const double>(targets[indices ? indices[b] : b]); });
+    }
+
+    void trainBatch(const DatasetView& batch) override {
+        checkShape(batch);
+        derived().trainSamples(batch.size(), inputsOf(batch), targetsOf(batch));
+    }
+    using Network::trainBatch;
+
+    // Utility methods
+    // Get network architecture
+    const std::vector<size_t>& getArchitecture() const override {
+        return architecture;
+    }
+
+    // Set learning rate
+    void setLearningRate(double lr) override {
+        learningRate = lr;
+    }
+
+    void setOptimizer(const Optimizer& opt) override {
+        optimizer = opt;
+        optimizerSteps = 0;
+        derived().resetOptimizerState();
+    }
+
+    void setSchedule(const Schedule& s) override {
+        schedule = s;
+    }
+
+    void setEvaluation(int interval, size_t samples = 0) override {
+        evaluationInterval = interval;
+        evaluationSamples = samples;
+    }
+
+    void setVerbose(bool v) override {
+        verbose = v;
+    }
+
+    void setCheckpointer(std::shared_ptr<Checkpointer> c, int interval) override {
+        checkpointer = std::move(c);
+        checkpointInterval = interval;
+    }
+
+    void setSeed(uint64_t seed) override {
+        generator = Rng(seed);
+    }
+
+    std::pair<std::pair<int, double>, std::pair<int, double>> getError() override {
+        return std::make_pair(cached_error, prev_error);
+    }
+
+    std::string toString() const override {
+        std::ostringstream oss;
+
+        // Build architecture string
+        oss << "Architecture: ";
+        for (size_t i = 0; i < architecture.size(); ++i) {
+            oss << architecture[i];
+            if (i < architecture.size() - 1) {
+                oss << " -> ";
+            }
+        }
+
+        // Add learning rate with 2 decimal places
+        oss << ". Learning Rate: " << std::fixed << std::setprecision(2) << learningRate;
+
+        return oss.str();
+    }
+};
+
+#endif /* network_base_hpp */
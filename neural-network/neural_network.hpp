@@ -9,213 +9,737 @@
 #define neural_network_hpp
 
 #include "matrix.hpp"
-#include <Accelerate/Accelerate.h>
+#include "network_base.hpp"
+#include "arena.hpp"
+#include "activation.hpp"
+#include "model_file.hpp"
+#include "execution_plan.hpp"
+#include "optimizer.hpp"
+#include "thread_pool.hpp"
 #include <vector>
+#include <string>
 #include <iostream>
 #include <cmath>
 #include <cassert>
-#include <random>
 #include <algorithm>
 #include <numeric>
 #include <utility>
+#include <type_traits>
+#include <memory>
 
-class NeuralNetwork {
+// Fully connected network computing in scalar type T, with an activation
+// function per layer (sigmoid everywhere by default). When Master
+// differs from T (e.g. float compute, double Master) the network keeps a
+// Master-precision copy of every weight and bias: forward and backward passes
+// run in T, and each update is applied to the master copy and rounded back
+// down, so small updates aren't lost to T's precision.
+//
+// The public API takes and returns std::vector<double> for every
+// instantiation; values are converted at the boundary.
+template <typename T = double, typename Master = T>
+class BasicNeuralNetwork final : public NetworkBase<BasicNeuralNetwork<T, Master>> {
 private:
-    std::vector<size_t> architecture;
-    std::vector<Matrix> weights;
-    std::vector<Matrix> biases;
-    double learningRate;
-    int totalEpochs;
-    std::pair<int, double> prev_error;
-    std::pair<int, double> cached_error;
+    using Base = NetworkBase<BasicNeuralNetwork<T, Master>>;
+    using Base::architecture;
+    using Base::optimizer;
+    using Base::totalEpochs;
+
+    using MatrixT = BasicMatrix<T>;
+    using MasterMatrix = BasicMatrix<Master>;
+    static constexpr bool mixedPrecision = !std::is_same_v<T, Master>;
+
+    std::vector<MatrixT> weights;
+    std::vector<MatrixT> biases;
+    // Master copies, only populated in mixed precision
+    std::vector<MasterMatrix> masterWeights;
+    std::vector<MasterMatrix> masterBiases;
+    // Optimizer state (velocity, or first and second moments) per layer, in
+    // Master precision; only the buffers the rule needs are populated
+    std::vector<MasterMatrix> weightState[2];
+    std::vector<MasterMatrix> biasState[2];
     
-    static double sigmoid(double x) {
-        return 1.0 / (1.0 + std::exp(-x));
+    // layerActivations[i] is applied to the output of weights[i]
+    std::vector<Activation> layerActivations;
+    
+    using View = StridedView<T>;
+    using ConstView = StridedView<const T>;
+
+    // Largest number of samples predictBatch pushes through at once
+    static constexpr size_t PREDICT_CHUNK = 8192;
+
+    // Smallest data-parallel shard: below this a shard's work doesn't
+    // cover the cost of handing it to another thread
+    static constexpr size_t MIN_SHARD_SAMPLES = 64;
+
+    // Values per cache line, the alignment of every plan buffer
+    static constexpr size_t PLAN_ALIGNMENT = Arena::ALIGNMENT / sizeof(T);
+
+    // Compiled schedules (see execution_plan.hpp). They depend only on the
+    // architecture and, for training, on whether the optimizer needs the
+    // weight gradient on its own, so they are rebuilt when that changes.
+    ExecutionPlan trainingPlan;
+    ExecutionPlan inferencePlan;
+
+    // Per-step scratch for one training thread. A step takes its plan's
+    // whole scratch buffer from `arena` in one allocation, which is reset
+    // in O(1) when the step ends, so once the arena has grown to its peak a
+    // step does no heap allocation at all.
+    struct Workspace {
+        Arena arena;
+        // Gradient sums of a data-parallel shard
+        std::vector<MatrixT> weightGrads;
+        std::vector<MatrixT> biasGrads;
+        // Squared output error of the samples trained on since it was last
+        // collected
+        double loss = 0.0;
+    };
+    Workspace workspace;
+    // One per data-parallel shard or Hogwild thread, created on first use
+    std::vector<std::unique_ptr<Workspace>> shards;
+
+    // Scratch for predict(). Per thread, so concurrent predictions on one
+    // network never share memory.
+    static Arena& inferenceArena() {
+        thread_local Arena scratch;
+        return scratch;
     }
-    static double dsigmoid(double x) {
-        double s = sigmoid(x);
-        return s * (1.0 - s);
+
+    void compilePlans() {
+        const bool gradients = mixedPrecision || optimizer.method != optim::Method::SGD;
+        trainingPlan = ExecutionPlan::training(architecture, layerActivations, gradients, PLAN_ALIGNMENT);
+        inferencePlan = ExecutionPlan::inference(architecture, layerActivations,
+                                                 !std::is_same_v<T, double>, PLAN_ALIGNMENT);
     }
-    
-    std::pair<std::vector<Matrix>, std::vector<Matrix>> forwardPropagate(const Matrix& input) const {
-        std::vector<Matrix> activations;
-        std::vector<Matrix> zValues; // Store z values for backprop
-        
-        Matrix currentActivation = input;
-        activations.push_back(currentActivation);
-        
+
+    // Every layer's weights and biases as views into one zeroed, contiguous
+    // allocation, each starting on a cache line
+    template <typename U>
+    static void allocateBlock(const std::vector<size_t>& layers,
+                              std::vector<BasicMatrix<U>>& w, std::vector<BasicMatrix<U>>& b) {
+        const size_t align = Arena::ALIGNMENT / sizeof(U);
+        auto padded = [&](size_t n) { return (n + align - 1) / align * align; };
+        size_t total = 0;
+        for (size_t i = 1; i < layers.size(); ++i) {
+            total += padded(layers[i] * layers[i - 1]) + padded(layers[i]);
+        }
+        auto block = std::make_shared<MatrixStorage<U>>(total);
+        U* next = block->data();
+        w.clear();
+        b.clear();
+        for (size_t i = 1; i < layers.size(); ++i) {
+            w.push_back(BasicMatrix<U>::borrow(next, layers[i], layers[i - 1], block));
+            next += padded(layers[i] * layers[i - 1]);
+            b.push_back(BasicMatrix<U>::borrow(next, layers[i], 1, block));
+            next += padded(layers[i]);
+        }
+    }
+
+    // Plan buffer `id` in `scratch`, as rows x n
+    static View planBuffer(const ExecutionPlan& plan, T* scratch, size_t id, size_t rows, size_t n) {
+        return View(scratch + plan.layout.offset(id, n), rows, n, n, 1);
+    }
+
+    // z = W * a + b for layer i, where a holds one sample per column: a
+    // GEMM (a GEMV for a single sample) accumulating onto the broadcast bias
+    void layerSum(View z, size_t i, ConstView a) const {
+        const T* b = biases[i].data();
+        for (size_t r = 0; r < z.numRows(); ++r) {
+            std::fill(z.data() + r * z.numCols(), z.data() + (r + 1) * z.numCols(), b[r]);
+        }
+        gemm<T>(z, weights[i].view(), a, T(1), T(1));
+    }
+
+    // Replays the inference plan on the samples stacked as columns of
+    // `input`. Each layer's sums are activated in place, and the planner
+    // has the layers ping-pong between two buffers. Returns a view into
+    // `scratch`, which holds inferencePlan.layout.size(n) values.
+    ConstView infer(T* scratch, ConstMatrixView input) const {
+        const ExecutionPlan& plan = inferencePlan;
+        const size_t n = input.numCols();
+        ConstView a;
+        if constexpr (std::is_same_v<T, double>) {
+            a = input;
+        } else {
+            View converted = planBuffer(plan, scratch, plan.activations[0], input.numRows(), n);
+            converted.assign(input);
+            a = converted;
+        }
+        for (const ExecutionPlan::Step& s : plan.steps) {
+            View z = planBuffer(plan, scratch, plan.activations[s.layer + 1], architecture[s.layer + 1], n);
+            layerSum(z, s.layer, a);
+            activation::forward<T>(layerActivations[s.layer], z.data(), z.data(), z.numRows(), n);
+            a = z;
+        }
+        return a;
+    }
+
+    static Master* stateOf(std::vector<MasterMatrix>& state, size_t i) {
+        return state.empty() ? nullptr : state[i].data();
+    }
+
+    // One optimizer step on layer i from its weight and bias gradients,
+    // scaled by gradScale. In mixed precision the step is applied to the
+    // master copies and rounded into the working weights in the same pass.
+    void applyUpdate(const optim::StepCoefficients& c, size_t i,
+                     const T* weightGrad, const T* biasGrad, Master gradScale) {
+        Master* ws1 = stateOf(weightState[0], i);
+        Master* ws2 = stateOf(weightState[1], i);
+        Master* bs1 = stateOf(biasState[0], i);
+        Master* bs2 = stateOf(biasState[1], i);
+        if constexpr (mixedPrecision) {
+            optim::update(optimizer, c, weights[i].size(), masterWeights[i].data(), weightGrad,
+                          gradScale, ws1, ws2, weights[i].data(), true);
+            optim::update(optimizer, c, biases[i].size(), masterBiases[i].data(), biasGrad,
+                          gradScale, bs1, bs2, biases[i].data(), false);
+        } else {
+            optim::update(optimizer, c, weights[i].size(), weights[i].data(), weightGrad,
+                          gradScale, ws1, ws2, static_cast<T*>(nullptr), true);
+            optim::update(optimizer, c, biases[i].size(), biases[i].data(), biasGrad,
+                          gradScale, bs1, bs2, static_cast<T*>(nullptr), false);
+        }
+    }
+
+    // Called by NetworkBase::setOptimizer
+    void resetOptimizerState() {
+        for (size_t s = 0; s < 2; ++s) {
+            weightState[s].clear();
+            biasState[s].clear();
+            if (s < optimizer.stateCount()) {
+                allocateBlock(architecture, weightState[s], biasState[s]);
+            }
+        }
+        compilePlans();
+    }
+    friend Base;
+
+    // Replays the training plan on `n` samples; input(b) and target(b)
+    // return sample b. Each layer is updated as soon as the delta below it
+    // is known, with the gradient averaged over the samples. With
+    // `accumulate` the updates are left out and each layer's gradient sums
+    // go to the workspace's shard buffers instead, which only reads the
+    // weights, so shards can run concurrently. An update takes the next
+    // optimizer step unless `step` gives its coefficients. The caller
+    // resets the arena.
+    template <typename Input, typename Target>
+    void replay(Workspace& ws, size_t n, Input input, Target target, bool accumulate,
+                const optim::StepCoefficients* step = nullptr) {
+        const ExecutionPlan& plan = trainingPlan;
+        T* scratch = ws.arena.template allocate<T>(plan.layout.size(n));
+        auto buffer = [&](size_t id, size_t rows) {
+            return planBuffer(plan, scratch, id, rows, n);
+        };
+
+        View in = buffer(plan.activations[0], architecture.front());
+        for (size_t b = 0; b < n; ++b) {
+            const std::span<const double> sample = input(b);
+            if (sample.size() != architecture.front()) {
+                throw std::invalid_argument("Sample size must match network layer");
+            }
+            for (size_t r = 0; r < sample.size(); ++r) {
+                in.data()[r * n + b] = static_cast<T>(sample[r]);
+            }
+        }
+        for (size_t b = 0; b < n; ++b) {
+            if (target(b).size() != architecture.back()) {
+                throw std::invalid_argument("Sample size must match network layer");
+            }
+        }
+
+        // Update() scales the weight gradient by 1 / n; the bias gradient
+        // is delta's row means
+        const T scale = T(1) / static_cast<T>(n);
+        const bool fusedSgd = !mixedPrecision && optimizer.method == optim::Method::SGD;
+        optim::StepCoefficients c{};
+        if (!accumulate) {
+            c = step ? *step : Base::nextStep();
+        }
+
+        for (const ExecutionPlan::Step& s : plan.steps) {
+            const size_t i = s.layer;
+            switch (s.op) {
+                case ExecutionPlan::Op::Forward: {
+                    View z = buffer(plan.sums[i], architecture[i + 1]);
+                    layerSum(z, i, buffer(plan.activations[i], architecture[i]));
+                    activation::forward<T>(layerActivations[i], z.data(),
+                                           buffer(plan.activations[i + 1], z.numRows()).data(), z.numRows(), n);
+                    break;
+                }
+                case ExecutionPlan::Op::OutputDelta: {
+                    const T* a = buffer(plan.activations[i + 1], architecture[i + 1]).data();
+                    T* delta = buffer(plan.deltas[i], architecture[i + 1]).data();
+                    double squaredError = 0.0;
+                    for (size_t r = 0; r < architecture[i + 1]; ++r) {
+                        for (size_t b = 0; b < n; ++b) {
+                            const T error = a[r * n + b] - static_cast<T>(target(b)[r]);
+                            delta[r * n + b] = error;
+                            squaredError += static_cast<double>(error) * static_cast<double>(error);
+                        }
+                    }
+                    ws.loss += squaredError;
+                    scaleByDerivative(plan, scratch, i, n);
+                    break;
+                }
+                case ExecutionPlan::Op::BackDelta: {
+                    gemm<T>(buffer(plan.deltas[i], architecture[i + 1]), weights[i + 1].view(),
+                            buffer(plan.deltas[i + 1], architecture[i + 2]), T(1), T(0), true, false);
+                    scaleByDerivative(plan, scratch, i, n);
+                    break;
+                }
+                case ExecutionPlan::Op::Update: {
+                    View delta = buffer(plan.deltas[i], architecture[i + 1]);
+                    View a = buffer(plan.activations[i], architecture[i]);
+                    if (accumulate) {
+                        gemm<T>(ws.weightGrads[i].view(), delta, a, T(1), T(0), false, true);
+                        View biasGrad = ws.biasGrads[i].view();
+                        biasGrad.assign(rowSums(delta, T(1), biasGrad));
+                        break;
+                    }
+                    View biasGrad(scratch + plan.layout.offset(plan.biasGradient, n), architecture[i + 1], 1, 1, 1);
+                    if (fusedSgd) {
+                        // Plain SGD folds the learning rate into the gradient GEMM
+                        const T lr = static_cast<T>(c.rate);
+                        gemm<T>(weights[i].view(), delta, a, -lr * scale, T(1), false, true);
+                        biases[i].view().axpy(-lr, rowSums(delta, scale, biasGrad));
+                    } else {
+                        View grad(scratch + plan.layout.offset(plan.weightGradient, n),
+                                  weights[i].numRows(), weights[i].numCols(), weights[i].numCols(), 1);
+                        gemm<T>(grad, delta, a, scale, T(0), false, true);
+                        applyUpdate(c, i, grad.data(), rowSums(delta, scale, biasGrad).data(), Master(1));
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    // delta *= f'(z) for layer i, from its output and, for GELU, its sums
+    void scaleByDerivative(const ExecutionPlan& plan, T* scratch, size_t i, size_t n) const {
+        const size_t rows = architecture[i + 1];
+        activation::backward<T>(layerActivations[i], planBuffer(plan, scratch, plan.activations[i + 1], rows, n).data(),
+                                planBuffer(plan, scratch, plan.sums[i], rows, n).data(),
+                                planBuffer(plan, scratch, plan.deltas[i], rows, n).data(), rows, n);
+    }
+
+    // Each row's sum times `scale`, written to the column `sums`; a single
+    // column is returned as is when scale is 1
+    static View rowSums(View m, T scale, View sums) {
+        if (m.numCols() == 1 && scale == T(1)) return m;
+        for (size_t r = 0; r < m.numRows(); ++r) {
+            const T* row = m.data() + r * m.numCols();
+            T sum = T(0);
+            for (size_t c = 0; c < m.numCols(); ++c) {
+                sum += row[c];
+            }
+            sums.data()[r] = sum * scale;
+        }
+        return sums;
+    }
+
+    // Makes sure there are `count` shard workspaces, with gradient
+    // buffers when `gradients` is set
+    void ensureShards(size_t count, bool gradients) {
+        while (shards.size() < count) {
+            shards.push_back(std::make_unique<Workspace>());
+        }
+        if (!gradients) return;
+        for (size_t s = 0; s < count; ++s) {
+            Workspace& ws = *shards[s];
+            if (ws.weightGrads.empty()) {
+                allocateBlock(architecture, ws.weightGrads, ws.biasGrads);
+            }
+        }
+    }
+
+    // Synchronous data-parallel step: the batch is split into `shardCount`
+    // contiguous shards, each shard sums its gradient into its own buffers,
+    // and the sums are combined by a pairwise tree reduction before a single
+    // update. Shard boundaries and the reduction order depend only on the
+    // batch size and shard count, never on scheduling, so the result is
+    // bit-reproducible for a given thread count.
+    template <typename Input, typename Target>
+    void parallelStep(size_t count, Input input, Target target, size_t shardCount) {
+        ensureShards(shardCount, true);
+
+        parallelFor(0, shardCount, 1, [&](size_t lo, size_t hi) {
+            for (size_t s = lo; s < hi; ++s) {
+                Workspace& ws = *shards[s];
+                Arena::Scope scope(ws.arena);
+                const size_t first = count * s / shardCount;
+                const size_t n = count * (s + 1) / shardCount - first;
+                replay(ws, n,
+                       [&](size_t b) { return input(first + b); },
+                       [&](size_t b) { return target(first + b); }, true);
+            }
+        });
+
+        for (size_t stride = 1; stride < shardCount; stride *= 2) {
+            const size_t pairs = (shardCount - stride + 2 * stride - 1) / (2 * stride);
+            parallelFor(0, pairs, 1, [&](size_t lo, size_t hi) {
+                for (size_t p = lo; p < hi; ++p) {
+                    Workspace& dst = *shards[p * 2 * stride];
+                    const Workspace& src = *shards[p * 2 * stride + stride];
+                    for (size_t i = 0; i < weights.size(); ++i) {
+                        dst.weightGrads[i].view().axpy(T(1), src.weightGrads[i].view());
+                        dst.biasGrads[i].view().axpy(T(1), src.biasGrads[i].view());
+                    }
+                }
+            });
+        }
+
+        double loss = 0.0;
+        for (size_t s = 0; s < shardCount; ++s) {
+            loss += std::exchange(shards[s]->loss, 0.0);
+        }
+        Base::addLoss(loss, count);
+
+        const Workspace& total = *shards[0];
+        const optim::StepCoefficients c = Base::nextStep();
         for (size_t i = 0; i < weights.size(); ++i) {
-            Matrix z = weights[i] * currentActivation + biases[i];
-            zValues.push_back(z);
-            currentActivation = z.apply(sigmoid);
-            activations.push_back(currentActivation);
+            applyUpdate(c, i, total.weightGrads[i].data(), total.biasGrads[i].data(),
+                        Master(1) / static_cast<Master>(count));
         }
-        
-        return std::make_pair(activations, zValues);
     }
-    
 
-public:
-    // Constructor: takes vector of layer sizes (including input and output)
-    NeuralNetwork(const std::vector<size_t>& layers, double lr = 0.5)
-    : architecture(layers), learningRate(lr), totalEpochs(0),
-    prev_error(std::make_pair(0, 0.0)), cached_error(std::make_pair(0, 0.0)) {
+    // One update on `count` samples (see NetworkBase). Stacks them as
+    // columns so every layer runs as one GEMM, with the gradient averaged
+    // over them. Batches of at least 2 * MIN_SHARD_SAMPLES are sharded
+    // across the thread pool.
+    template <typename Input, typename Target>
+    void trainSamples(size_t count, Input input, Target target) {
+        if (count == 0) return;
+
+        const size_t shardCount = std::min(ThreadPool::instance().threadCount(), count / MIN_SHARD_SAMPLES);
+        if (shardCount > 1 && !ThreadPool::onWorkerThread()) {
+            parallelStep(count, input, target, shardCount);
+            return;
+        }
+
+        Arena::Scope scope(workspace.arena);
+        replay(workspace, count, input, target, false);
+        Base::addLoss(std::exchange(workspace.loss, 0.0), count);
+    }
+
+    // Checks the topology but leaves the weights empty, for load()
+    struct Uninitialised {};
+    BasicNeuralNetwork(const std::vector<size_t>& layers, double lr,
+                       const std::vector<Activation>& activations, Uninitialised)
+    : Base(layers, lr), layerActivations(activations) {
         if (layers.size() < 2) {
             throw std::invalid_argument("Neural network must have at least input and output layers");
         }
-        
-        // Initialize weights and biases
-        for (size_t i = 1; i < layers.size(); ++i) {
-            // Weight matrix: current layer size × previous layer size
-            Matrix w(layers[i], layers[i-1]);
-            w.randomize(-2.0, 2.0);
-            weights.push_back(w);
-            
-            // Bias vector: current layer size × 1
-            Matrix b(layers[i], 1);
-            b.randomize(-1.0, 1.0);
-            biases.push_back(b);
+        if (layerActivations.empty()) {
+            layerActivations.assign(layers.size() - 1, Activation::Sigmoid);
+        }
+        if (layerActivations.size() != layers.size() - 1) {
+            throw std::invalid_argument("Need one activation per layer after the input");
+        }
+        compilePlans();
+    }
+
+    // Weights and biases from a model file stored as U. Master matrices
+    // borrow the file's pages when U is Master and are converted into a
+    // parameter block otherwise; in mixed precision the working copies are
+    // rounded from them as usual.
+    template <typename U>
+    void loadLayers(const model::File& file) {
+        std::vector<MasterMatrix> w;
+        std::vector<MasterMatrix> b;
+        if constexpr (!std::is_same_v<U, Master>) {
+            allocateBlock(architecture, w, b);
+        }
+        for (size_t i = 1; i < architecture.size(); ++i) {
+            BasicMatrix<U> fileWeights = BasicMatrix<U>::borrow(file.template weights<U>(i - 1),
+                                                                architecture[i], architecture[i - 1], file.mapping);
+            BasicMatrix<U> fileBiases = BasicMatrix<U>::borrow(file.template biases<U>(i - 1),
+                                                               architecture[i], 1, file.mapping);
+            if constexpr (std::is_same_v<U, Master>) {
+                w.push_back(std::move(fileWeights));
+                b.push_back(std::move(fileBiases));
+            } else {
+                w[i - 1].assignFrom(fileWeights);
+                b[i - 1].assignFrom(fileBiases);
+            }
+        }
+        if constexpr (mixedPrecision) {
+            allocateBlock(architecture, weights, biases);
+            for (size_t i = 0; i < weights.size(); ++i) {
+                weights[i].assignFrom(w[i]);
+                biases[i].assignFrom(b[i]);
+            }
+            masterWeights = std::move(w);
+            masterBiases = std::move(b);
+        } else {
+            weights = std::move(w);
+            biases = std::move(b);
+        }
+    }
+
+public:
+    // Constructor: takes vector of layer sizes (including input and output)
+    // and optionally one activation per weight layer (sigmoid when empty)
+    BasicNeuralNetwork(const std::vector<size_t>& layers, double lr = 0.5,
+                       const std::vector<Activation>& activations = {})
+    : BasicNeuralNetwork(layers, lr, activations, Uninitialised()) {
+        // Weight matrices are current layer size × previous layer size and
+        // bias vectors current layer size × 1, all in one parameter block
+        allocateBlock(layers, weights, biases);
+        if constexpr (mixedPrecision) {
+            allocateBlock(layers, masterWeights, masterBiases);
+        }
+        for (size_t i = 0; i < weights.size(); ++i) {
+            if constexpr (mixedPrecision) {
+                masterWeights[i].randomize(-2.0, 2.0, this->generator);
+                masterBiases[i].randomize(-1.0, 1.0, this->generator);
+                weights[i].assignFrom(masterWeights[i]);
+                biases[i].assignFrom(masterBiases[i]);
+            } else {
+                weights[i].randomize(-2.0, 2.0, this->generator);
+                biases[i].randomize(-1.0, 1.0, this->generator);
+            }
         }
     }
     
     // Prediction methods
-    std::vector<double> predict(const std::vector<double>& input) const {
-        if (input.size() != architecture[0]) {
+    std::vector<double> predict(const std::vector<double>& input) const override {
+        std::vector<double> output(architecture.back());
+        predict(input, output);
+        return output;
+    }
+
+    // Scratch comes from the calling thread's inference arena, so this is
+    // safe to call from several threads at once and, once the arena has
+    // warmed up, never allocates
+    void predict(std::span<const double> input, std::span<double> output) const override {
+        if (input.size() != architecture.front()) {
             throw std::invalid_argument("Input size must match network input layer");
         }
-        // Convert input to matrix
-        Matrix inputMatrix(input.size(), 1);
-        for (size_t i = 0; i < input.size(); ++i) {
-            inputMatrix(i, 0) = input[i];
+        if (output.size() != architecture.back()) {
+            throw std::invalid_argument("Output size must match network output layer");
         }
-        
-        auto result = forwardPropagate(inputMatrix);
-        return result.first.back().toVector();
+        Arena& scratch = inferenceArena();
+        Arena::Scope scope(scratch);
+
+        ConstView a = infer(scratch.allocate<T>(inferencePlan.layout.size(1)),
+                            ConstMatrixView(input.data(), input.size(), 1, 1, 1));
+        std::copy(a.data(), a.data() + output.size(), output.begin());
+    }
+
+    // Every layer runs as one GEMM over the whole batch, with samples as
+    // columns. Very large batches go through in chunks of PREDICT_CHUNK so
+    // the inference arena stays bounded.
+    void predictBatch(std::span<const double> inputs, std::span<double> outputs) const override {
+        const size_t count = Base::batchCount(inputs, outputs);
+        const size_t inputSize = architecture.front();
+        const size_t outputSize = architecture.back();
+        Arena& scratch = inferenceArena();
+
+        for (size_t first = 0; first < count; first += PREDICT_CHUNK) {
+            const size_t n = std::min(PREDICT_CHUNK, count - first);
+            Arena::Scope scope(scratch);
+
+            // Samples are rows of the buffers and columns of the activations
+            ConstMatrixView samples(inputs.data() + first * inputSize, n, inputSize, inputSize, 1);
+            ConstView a = infer(scratch.allocate<T>(inferencePlan.layout.size(n)), samples.transposed());
+            MatrixView(outputs.data() + first * outputSize, n, outputSize, outputSize, 1).transposed().assign(a);
+        }
+    }
+    using Base::predictBatch;
+
+    // One sample per row in, one prediction per row out
+    Matrix predictBatch(const Matrix& inputs) const {
+        Matrix outputs(inputs.numRows(), architecture.back());
+        predictBatch(std::span<const double>(inputs.data(), inputs.size()),
+                     std::span<double>(outputs.data(), outputs.size()));
+        return outputs;
     }
     
     // Training methods
-    void trainSingle(const std::vector<double>& input, const std::vector<double>& target) {
-            assert(input.size() == architecture[0] && "Input size must match network input layer");
-            assert(target.size() == architecture.back() && "Target size must match network output layer");
-            
-            // Convert input to matrix
-            Matrix inputMatrix(input.size(), 1);
-            for (size_t i = 0; i < input.size(); ++i) {
-                inputMatrix(i, 0) = input[i];
-            }
-            
-            // Convert target to matrix
-            Matrix targetMatrix(target.size(), 1);
-            for (size_t i = 0; i < target.size(); ++i) {
-                targetMatrix(i, 0) = target[i];
-            }
-            
-            // Forward propagation
-            auto forwardResult = forwardPropagate(inputMatrix);
-            std::vector<Matrix> activations = forwardResult.first;
-            std::vector<Matrix> zValues = forwardResult.second;
-            
-            // Backward propagation
-            std::vector<Matrix> deltas;
-            deltas.resize(weights.size());
-            
-            // Calculate output layer delta (error * sigmoid derivative)
-            Matrix outputError = activations.back() - targetMatrix;
-            Matrix sigmoidDeriv = zValues.back().apply(dsigmoid);
-            deltas[deltas.size() - 1] = outputError.hadamard(sigmoidDeriv);
-            
-            // Calculate hidden layer deltas (backpropagate)
-            for (int i = (int)(weights.size()) - 2; i >= 0; --i) {
-                Matrix error = weights[i + 1].transpose() * deltas[i + 1];
-                Matrix sigmoidDeriv = zValues[i].apply(dsigmoid);
-                deltas[i] = error.hadamard(sigmoidDeriv);
-            }
-            
-            // Update weights and biases
-            for (size_t i = 0; i < weights.size(); ++i) {
-                // Calculate gradients
-                Matrix weightGradient = deltas[i] * activations[i].transpose();
-                Matrix biasGradient = deltas[i];
-                
-                // Update weights and biases
-                weights[i] = weights[i] - (weightGradient * learningRate);
-                biases[i] = biases[i] - (biasGradient * learningRate);
+    // Sizes the training scratch for batches of up to batchSize, so the
+    // first steps don't have to grow it. The plans themselves don't depend
+    // on the batch size: they are compiled with the network and again when
+    // the optimizer changes.
+    void compile(size_t batchSize) {
+        workspace.arena.reserve(trainingPlan.layout.size(std::max<size_t>(batchSize, 1)) * sizeof(T));
+    }
+
+    const ExecutionPlan& getTrainingPlan() const {
+        return trainingPlan;
+    }
+    const ExecutionPlan& getInferencePlan() const {
+        return inferencePlan;
+    }
+
+    // Asynchronous lock-free SGD (Hogwild): every pool thread runs
+    // per-sample steps over its own slice of each epoch, reading and
+    // updating the shared weights without synchronisation. Updates can
+    // overwrite each other, so unlike train() the result isn't
+    // reproducible; with sparse, small updates this converges at close to
+    // serial quality per epoch while scaling with the thread count. The
+    // races are deliberate and will show up under ThreadSanitizer. A
+    // stateful optimizer's buffers are shared in the same way. The step
+    // count is not: each epoch's steps are claimed up front and share one
+    // set of coefficients.
+    void trainHogwild(const std::vector<std::vector<double>>& inputs,
+                      const std::vector<std::vector<double>>& targets,
+                      int epochs = 1000,
+                      bool shuffle = true) {
+        assert(inputs.size() == targets.size() && "Number of inputs must match number of targets");
+        const size_t threads = ThreadPool::instance().threadCount();
+        ensureShards(threads, false);
+
+        std::vector<size_t> indices(inputs.size());
+        std::iota(indices.begin(), indices.end(), 0);
+
+        for (int epoch = 0; epoch < epochs; ++epoch) {
+            if (shuffle) {
+                this->generator.shuffle(indices.begin(), indices.end());
             }
-        }
-        
-        // Train on batch of data
-        void train(const std::vector<std::vector<double>>& inputs,
-                   const std::vector<std::vector<double>>& targets,
-                   int epochs = 1000,
-                   bool shuffle = true) {
-            
-            assert(inputs.size() == targets.size() && "Number of inputs must match number of targets");
-            
-            std::vector<size_t> indices(inputs.size());
-            std::iota(indices.begin(), indices.end(), 0);
-            
-            for (int epoch = 0; epoch < epochs; ++epoch) {
-                if (shuffle) {
-                    std::random_device rd;
-                    std::mt19937 g(rd());
-                    std::shuffle(indices.begin(), indices.end(), g);
-                }
-                
-                for (size_t idx : indices) {
-                    trainSingle(inputs[idx], targets[idx]);
-                }
-                
-                // Print progress every 100 epochs
-                totalEpochs++;
-            }
-            double totalError = 0.0;
-            for (size_t i = 0; i < inputs.size(); ++i) {
-                std::vector<double> prediction = predict(inputs[i]);
-                for (size_t j = 0; j < prediction.size(); ++j) {
-                    double error = prediction[j] - targets[i][j];
-                    totalError += error * error;
+            const optim::StepCoefficients c = Base::claimSteps(static_cast<long>(indices.size()));
+            parallelFor(0, threads, 1, [&](size_t lo, size_t hi) {
+                for (size_t t = lo; t < hi; ++t) {
+                    Workspace& ws = *shards[t];
+                    for (size_t k = t; k < indices.size(); k += threads) {
+                        Arena::Scope scope(ws.arena);
+                        const size_t i = indices[k];
+                        replay(ws, 1,
+                               [&](size_t) { return std::span<const double>(inputs[i]); },
+                               [&](size_t) { return std::span<const double>(targets[i]); }, false, &c);
+                    }
                 }
+            });
+            double loss = 0.0;
+            for (size_t t = 0; t < threads; ++t) {
+                loss += std::exchange(shards[t]->loss, 0.0);
+            }
+            Base::addLoss(loss, indices.size());
+            Base::finishEpoch();
+            if (epoch + 1 < epochs) {
+                Base::checkpointIfDue();
             }
-            prev_error = cached_error;
-            cached_error = std::make_pair(totalEpochs, totalError / inputs.size());
-            std::cout << "Epoch " << totalEpochs << ", Average Error: "
-                      << totalError / inputs.size() << std::endl;
         }
-    
-    // Utility methods
-    // Get network architecture
-    const std::vector<size_t>& getArchitecture() const {
-        return architecture;
+        Base::recordError(inputs.size(), Base::samplesOf(inputs), Base::samplesOf(targets));
+        Base::checkpointIfDue();
     }
-    
-    // Set learning rate
-    void setLearningRate(double lr) {
-        learningRate = lr;
+
+    // Writes the network to `path` in the binary model format (see
+    // model_file.hpp), at Master precision
+    void save(const std::string& path) const {
+        std::vector<const Master*> w;
+        std::vector<const Master*> b;
+        for (size_t i = 0; i < weights.size(); ++i) {
+            if constexpr (mixedPrecision) {
+                w.push_back(masterWeights[i].data());
+                b.push_back(masterBiases[i].data());
+            } else {
+                w.push_back(weights[i].data());
+                b.push_back(biases[i].data());
+            }
+        }
+        model::write<Master>(path, Base::learningRate, architecture, layerActivations, w, b);
     }
-    
-    std::pair<std::pair<int, double>, std::pair<int, double>> getError() {
-        return std::make_pair(cached_error, prev_error);
+
+    // Loads a model written by save(). The file is memory-mapped, and when
+    // it stores the network's Master type the weights are used in place:
+    // nothing is copied or parsed, and the pages are only read in as
+    // layers first touch them. verify = false skips the checksum, which
+    // otherwise reads the whole file.
+    static std::unique_ptr<BasicNeuralNetwork> load(const std::string& path, bool verify = true) {
+        const model::File file = model::open(path, verify);
+        std::unique_ptr<BasicNeuralNetwork> network(new BasicNeuralNetwork(
+            file.layers, file.header.learningRate, file.activations, Uninitialised()));
+        if (file.scalarType() == model::ScalarType::Float64) {
+            network->template loadLayers<double>(file);
+        } else {
+            network->template loadLayers<float>(file);
+        }
+        return network;
     }
-    
-    std::string toString() const {
-        std::ostringstream oss;
-        
-        // Build architecture string
-        oss << "Architecture: ";
-        for (size_t i = 0; i < architecture.size(); ++i) {
-            oss << architecture[i];
-            if (i < architecture.size() - 1) {
-                oss << " -> ";
+
+    // Buffers: every layer's weights and biases at Master precision, then
+    // the optimizer state the rule uses, the same way round
+    TrainingState captureState() const override {
+        TrainingState state = Base::captureBase();
+        auto add = [&](const auto& m) {
+            state.buffers.emplace_back(m.data(), m.data() + m.size());
+        };
+        for (size_t i = 0; i < weights.size(); ++i) {
+            if constexpr (mixedPrecision) {
+                add(masterWeights[i]);
+                add(masterBiases[i]);
+            } else {
+                add(weights[i]);
+                add(biases[i]);
             }
         }
-        
-        // Add learning rate with 2 decimal places
-        oss << ". Learning Rate: " << std::fixed << std::setprecision(2) << learningRate;
-        
-        return oss.str();
+        for (size_t s = 0; s < 2; ++s) {
+            for (size_t i = 0; i < weightState[s].size(); ++i) {
+                add(weightState[s][i]);
+                add(biasState[s][i]);
+            }
+        }
+        return state;
+    }
+
+    void restoreState(const TrainingState& state) override {
+        const size_t layerCount = weights.size();
+        // Buffers in captureState() order: the parameters, then one copy of
+        // their shapes per optimizer state buffer of the saved optimizer
+        std::vector<size_t> sizes;
+        for (size_t s = 0; s < 1 + state.optimizer.stateCount(); ++s) {
+            for (size_t i = 0; i < layerCount; ++i) {
+                sizes.push_back(weights[i].size());
+                sizes.push_back(biases[i].size());
+            }
+        }
+        Base::restoreBase(state, sizes);
+        resetOptimizerState();
+        size_t next = 0;
+        auto load = [&](auto& m) {
+            const std::vector<double>& values = state.buffers[next++];
+            std::copy(values.begin(), values.end(), m.data());
+        };
+        for (size_t i = 0; i < layerCount; ++i) {
+            if constexpr (mixedPrecision) {
+                load(masterWeights[i]);
+                load(masterBiases[i]);
+                weights[i].assignFrom(masterWeights[i]);
+                biases[i].assignFrom(masterBiases[i]);
+            } else {
+                load(weights[i]);
+                load(biases[i]);
+            }
+        }
+        for (size_t s = 0; s < 2; ++s) {
+            for (size_t i = 0; i < weightState[s].size(); ++i) {
+                load(weightState[s][i]);
+                load(biasState[s][i]);
+            }
+        }
+    }
+
+    // Weights (layers[i + 1] x layers[i]) and biases of weight layer i, in
+    // the compute type
+    const MatrixT& getWeights(size_t i) const {
+        return weights.at(i);
+    }
+    const MatrixT& getBiases(size_t i) const {
+        return biases.at(i);
+    }
+
+    const std::vector<Activation>& getActivations() const {
+        return layerActivations;
+    }
+
+    // Scratch arena statistics, for sizing production models. The
+    // inference arena is the calling thread's.
+    const Arena& getArena() const {
+        return workspace.arena;
+    }
+    static const Arena& getInferenceArena() {
+        return inferenceArena();
     }
     
-    friend std::ostream& operator<<(std::ostream& os, const NeuralNetwork& network) {
+    friend std::ostream& operator<<(std::ostream& os, const BasicNeuralNetwork& network) {
         
         os << "Neural Network:" << std::endl;
         os << "  Architecture: ";
@@ -237,4 +761,9 @@ public:
     }
 };
 
+using NeuralNetwork = BasicNeuralNetwork<double>;
+using NeuralNetworkF = BasicNeuralNetwork<float>;
+// Float compute with double master weights
+using MixedPrecisionNetwork = BasicNeuralNetwork<float, double>;
+
 #endif /* neural_network_hpp */
@@ -25,8 +25,12 @@ private:
     SDL_Window* window;
     SDL_Renderer* renderer;
     TTF_Font* font;
-    std::unique_ptr<NeuralNetwork> network;
+    std::unique_ptr<Network> network;
     std::unique_ptr<Problem> problem;
+    // Decision-boundary sample points, (i0, i1) per grid cell in column-major
+    // cell order, and the network's prediction for each
+    std::vector<double> grid;
+    std::vector<double> gridPredictions;
 
     void render_problem() {
         SDL_SetRenderDrawColor(renderer, 17, 17, 17, 255); // Dark background
@@ -43,20 +47,28 @@ private:
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderFillRect(renderer, &canvas);
 
-        // Train network
-        auto inputs = problem->getInputs();
-        auto outputs = problem->getOutputs();
+        // Train network, straight from the problem's data
         auto epochs = problem->getEpochs();
-        network->train(inputs, outputs, epochs, true);
+        network->train(problem->getData(), epochs, true);
         
         // Visualize decision boundary
         double cols = canvas.w / RESOLUTION;
         double rows = canvas.h / RESOLUTION;
+        if (grid.empty()) {
+            for (int i = 0; i < cols; ++i) {
+                for (int j = 0; j < rows; ++j) {
+                    grid.push_back(static_cast<double>(i) / cols);
+                    grid.push_back(static_cast<double>(j) / rows);
+                }
+            }
+            gridPredictions.resize(grid.size() / 2 * network->getArchitecture().back());
+        }
+        // Whole grid in one batched pass
+        network->predictBatch(grid, gridPredictions);
+        const size_t outputSize = network->getArchitecture().back();
         for (int i = 0; i < cols; ++i) {
             for (int j = 0; j < rows; ++j) {
-                double i0 = static_cast<double>(i) / cols;
-                double i1 = static_cast<double>(j) / rows;
-                double prediction = network->predict({i0, i1})[0];
+                double prediction = gridPredictions[(i * static_cast<size_t>(rows) + j) * outputSize];
                 
                 SDL_Rect rect;
                 rect.x = i * RESOLUTION + x_off;
@@ -122,7 +134,9 @@ public:
     NerualVis(std::unique_ptr<Problem> prob) {
         problem = std::move(prob);
         // Create neural network based on problem
-        network = std::make_unique<NeuralNetwork>(problem->getArchitecture(), problem->getLearningRate());
+        network = problem->createNetwork();
+        // The error is drawn every frame, no need to print it too
+        network->setVerbose(false);
         
         window = nullptr;
         renderer = nullptr;
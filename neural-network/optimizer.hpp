@@ -0,0 +1,253 @@
+//
+//  optimizer.hpp
+//  neural-network
+//
+//  Update rules and learning-rate schedules shared by the network engines.
+//
+//  An Optimizer describes the rule (plain SGD, momentum, Nesterov momentum,
+//  RMSProp, Adam or AdamW) and its hyperparameters; the engines own the
+//  per-parameter state (velocity, first and second moments) next to each
+//  weight and bias matrix. update() applies one step to a contiguous
+//  parameter block: it reads the gradient, updates the state and the
+//  parameters, and for mixed-precision networks rounds the result into the
+//  working copy, all in a single pass with the rule chosen outside the
+//  loop.
+//
+//  A Schedule scales the base learning rate by epoch: step decay,
+//  exponential decay or cosine annealing, each with an optional linear
+//  warmup.
+//
+
+#ifndef optimizer_hpp
+#define optimizer_hpp
+
+#include "matrix.hpp"
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+
+namespace optim {
+
+enum class Method { SGD, Momentum, Nesterov, RMSProp, Adam, AdamW };
+
+inline const char* name(Method method) {
+    switch (method) {
+        case Method::SGD: return "sgd";
+        case Method::Momentum: return "momentum";
+        case Method::Nesterov: return "nesterov";
+        case Method::RMSProp: return "rmsprop";
+        case Method::Adam: return "adam";
+        case Method::AdamW: return "adamw";
+    }
+    return "unknown";
+}
+
+struct Optimizer {
+    Method method = Method::SGD;
+    double momentum = 0.9;      // Momentum, Nesterov
+    double decay = 0.9;         // RMSProp moving average of g^2
+    double beta1 = 0.9;         // Adam, AdamW
+    double beta2 = 0.999;
+    double epsilon = 1e-8;
+    double weightDecay = 0.01;  // AdamW, applied to weights but not biases
+
+    static Optimizer sgd() {
+        return Optimizer();
+    }
+    static Optimizer withMomentum(double momentum = 0.9, bool nesterov = false) {
+        Optimizer opt;
+        opt.method = nesterov ? Method::Nesterov : Method::Momentum;
+        opt.momentum = momentum;
+        return opt;
+    }
+    static Optimizer rmsprop(double decay = 0.9, double epsilon = 1e-8) {
+        Optimizer opt;
+        opt.method = Method::RMSProp;
+        opt.decay = decay;
+        opt.epsilon = epsilon;
+        return opt;
+    }
+    static Optimizer adam(double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8) {
+        Optimizer opt;
+        opt.method = Method::Adam;
+        opt.beta1 = beta1;
+        opt.beta2 = beta2;
+        opt.epsilon = epsilon;
+        return opt;
+    }
+    static Optimizer adamW(double weightDecay = 0.01, double beta1 = 0.9, double beta2 = 0.999) {
+        Optimizer opt = adam(beta1, beta2);
+        opt.method = Method::AdamW;
+        opt.weightDecay = weightDecay;
+        return opt;
+    }
+
+    // Number of state buffers per parameter: velocity for the momentum
+    // rules, the g^2 average for RMSProp, both moments for Adam
+    size_t stateCount() const {
+        switch (method) {
+            case Method::SGD: return 0;
+            case Method::Momentum:
+            case Method::Nesterov:
+            case Method::RMSProp: return 1;
+            case Method::Adam:
+            case Method::AdamW: return 2;
+        }
+        return 0;
+    }
+};
+
+// Per-step constants: the learning rate, and Adam's bias corrections for
+// step t (counting from 1)
+struct StepCoefficients {
+    double rate;
+    double correction1;
+    double correction2;
+};
+
+inline StepCoefficients coefficients(const Optimizer& opt, double rate, long step) {
+    StepCoefficients c{rate, 1.0, 1.0};
+    if (opt.method == Method::Adam || opt.method == Method::AdamW) {
+        c.correction1 = 1.0 / (1.0 - std::pow(opt.beta1, static_cast<double>(step)));
+        c.correction2 = 1.0 / (1.0 - std::pow(opt.beta2, static_cast<double>(step)));
+    }
+    return c;
+}
+
+// One step on n contiguous parameters of type P. The gradient is
+// gradScale * grad[k] (so callers can pass un-averaged sums); s1 and s2 are
+// the rule's state buffers, unused ones may be null. When W differs from P
+// (mixed precision: P the master copy, W the working copy) each updated
+// parameter is also rounded into working[k]. `decay` enables AdamW's
+// weight decay for this block.
+template <typename P, typename G, typename W = P>
+inline void update(const Optimizer& opt, const StepCoefficients& c, size_t n,
+                   P* params, const G* grad, P gradScale, P* s1, P* s2,
+                   W* working = nullptr, bool decay = true) {
+    constexpr bool round = !std::is_same_v<W, P>;
+    const P lr = static_cast<P>(c.rate);
+    const P mu = static_cast<P>(opt.momentum);
+    const P rho = static_cast<P>(opt.decay);
+    const P b1 = static_cast<P>(opt.beta1);
+    const P b2 = static_cast<P>(opt.beta2);
+    const P eps = static_cast<P>(opt.epsilon);
+    const P c1 = static_cast<P>(c.correction1);
+    const P c2 = static_cast<P>(c.correction2);
+    const P wd = decay && opt.method == Method::AdamW ? static_cast<P>(opt.weightDecay) : P(0);
+
+    // `rule` maps (k, g, p) to the new parameter value
+    auto sweep = [&](auto rule) {
+        forEachRange(n, [&](size_t lo, size_t hi) {
+            for (size_t k = lo; k < hi; ++k) {
+                const P p = rule(k, gradScale * static_cast<P>(grad[k]), params[k]);
+                params[k] = p;
+                if constexpr (round) {
+                    working[k] = static_cast<W>(p);
+                }
+            }
+        });
+    };
+
+    switch (opt.method) {
+        case Method::SGD:
+            sweep([&](size_t, P g, P p) { return p - lr * g; });
+            break;
+        case Method::Momentum:
+            sweep([&](size_t k, P g, P p) {
+                s1[k] = mu * s1[k] + g;
+                return p - lr * s1[k];
+            });
+            break;
+        case Method::Nesterov:
+            sweep([&](size_t k, P g, P p) {
+                s1[k] = mu * s1[k] + g;
+                return p - lr * (g + mu * s1[k]);
+            });
+            break;
+        case Method::RMSProp:
+            sweep([&](size_t k, P g, P p) {
+                s1[k] = rho * s1[k] + (P(1) - rho) * g * g;
+                return p - lr * g / (std::sqrt(s1[k]) + eps);
+            });
+            break;
+        case Method::Adam:
+        case Method::AdamW:
+            sweep([&](size_t k, P g, P p) {
+                s1[k] = b1 * s1[k] + (P(1) - b1) * g;
+                s2[k] = b2 * s2[k] + (P(1) - b2) * g * g;
+                return p - lr * ((s1[k] * c1) / (std::sqrt(s2[k] * c2) + eps) + wd * p);
+            });
+            break;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Learning-rate schedules
+// ---------------------------------------------------------------------------
+
+struct Schedule {
+    enum class Type { Constant, Step, Exponential, Cosine };
+
+    Type type = Type::Constant;
+    double gamma = 0.5;         // Step: factor every `period` epochs; Exponential: factor per epoch
+    int period = 1000;          // Step: epochs between decays; Cosine: epochs to anneal over
+    double minFactor = 0.0;     // Cosine: floor, as a fraction of the base rate
+    int warmup = 0;             // Epochs of linear warmup from 0, before the schedule starts
+
+    static Schedule constant() {
+        return Schedule();
+    }
+    static Schedule step(int period, double gamma = 0.5) {
+        Schedule s;
+        s.type = Type::Step;
+        s.period = period;
+        s.gamma = gamma;
+        return s;
+    }
+    static Schedule exponential(double gamma) {
+        Schedule s;
+        s.type = Type::Exponential;
+        s.gamma = gamma;
+        return s;
+    }
+    static Schedule cosine(int period, double minFactor = 0.0) {
+        Schedule s;
+        s.type = Type::Cosine;
+        s.period = period;
+        s.minFactor = minFactor;
+        return s;
+    }
+    Schedule& withWarmup(int epochs) {
+        warmup = epochs;
+        return *this;
+    }
+
+    // Learning rate for `epoch` (counting from 0)
+    double rate(double base, int epoch) const {
+        if (epoch < warmup) {
+            return base * static_cast<double>(epoch + 1) / static_cast<double>(warmup + 1);
+        }
+        const int e = epoch - warmup;
+        switch (type) {
+            case Type::Constant:
+                return base;
+            case Type::Step:
+                return base * std::pow(gamma, static_cast<double>(e / std::max(period, 1)));
+            case Type::Exponential:
+                return base * std::pow(gamma, static_cast<double>(e));
+            case Type::Cosine: {
+                const double progress = std::min(1.0, static_cast<double>(e) / std::max(period, 1));
+                return base * (minFactor + (1.0 - minFactor) * 0.5 * (1.0 + std::cos(M_PI * progress)));
+            }
+        }
+        return base;
+    }
+};
+
+} // namespace optim
+
+using Optimizer = optim::Optimizer;
+using Schedule = optim::Schedule;
+
+#endif /* optimizer_hpp */
@@ -0,0 +1,288 @@
+//
+//  pipeline.hpp
+//  neural-network
+//
+//  Input pipeline that prepares batches while the network trains. A
+//  Prefetcher runs a BatchSource (a BatchSampler over data in memory, or a
+//  dataset::Loader over a file) on a background thread, which shuffles,
+//  gathers each batch into a contiguous buffer and applies an optional
+//  augmentation. Batches are handed to the training thread through a
+//  bounded lock-free ring of `depth` slots: with the default of two, one
+//  batch is trained on while the next is filled, so the training loop only
+//  waits when producing a batch takes longer than training on one.
+//
+//      BatchSampler batches(problem->getData(), 32);
+//      Prefetcher prefetcher(batches);
+//      network.train(prefetcher, epochs);
+//
+
+#ifndef pipeline_hpp
+#define pipeline_hpp
+
+#include "dataset.hpp"
+#include "random.hpp"
+#include "aligned_allocator.hpp"
+#include <vector>
+#include <span>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <cstddef>
+
+// Bounded single-producer, single-consumer ring of slots that are filled
+// in place and reused, so passing a batch along copies nothing. Neither
+// side takes a lock; a side that finds the ring full (resp. empty) sleeps
+// on an atomic wait until the other side moves.
+template <typename T>
+class SpscRing {
+private:
+    std::vector<T> slots;
+    // Slots published by the producer and released by the consumer, on
+    // separate cache lines so the two sides don't contend
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    // Bumped on every publish, release and close, for waiters to sleep on
+    alignas(64) std::atomic<uint64_t> events{0};
+    std::atomic<bool> closed{false};
+
+    void signal() {
+        events.fetch_add(1, std::memory_order_release);
+        events.notify_all();
+    }
+
+public:
+    explicit SpscRing(size_t capacity) : slots(std::max<size_t>(capacity, 1)) {}
+
+    size_t capacity() const { return slots.size(); }
+
+    // Producer: the next slot to fill, once one is free; null once closed
+    T* reserve() {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        while (true) {
+            const uint64_t seen = events.load(std::memory_order_acquire);
+            if (closed.load(std::memory_order_acquire)) return nullptr;
+            if (h - tail.load(std::memory_order_acquire) < slots.size()) return &slots[h % slots.size()];
+            events.wait(seen, std::memory_order_acquire);
+        }
+    }
+    // Producer: hands the reserved slot to the consumer
+    void publish() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        signal();
+    }
+
+    // Consumer: true when front() would not wait
+    bool ready() const {
+        return head.load(std::memory_order_acquire) != tail.load(std::memory_order_relaxed);
+    }
+    // Consumer: the oldest published slot, once there is one; null once
+    // closed
+    T* front() {
+        const uint64_t t = tail.load(std::memory_order_relaxed);
+        while (true) {
+            const uint64_t seen = events.load(std::memory_order_acquire);
+            if (head.load(std::memory_order_acquire) != t) return &slots[t % slots.size()];
+            if (closed.load(std::memory_order_acquire)) return nullptr;
+            events.wait(seen, std::memory_order_acquire);
+        }
+    }
+    // Consumer: returns the front slot to the producer
+    void release() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        signal();
+    }
+
+    // Wakes both sides for good; the producer gets no more slots
+    void close() {
+        closed.store(true, std::memory_order_release);
+        signal();
+    }
+};
+
+// Batches of a data set held in memory, in a new random order each epoch
+// (or in order, handed out in place). Shuffled batches are gathered into
+// buffers the sampler owns.
+class BatchSampler : public BatchSource {
+private:
+    DatasetView data;
+    size_t batchSize;
+    bool shuffle;
+    Rng generator;
+    std::vector<size_t> indices;
+    size_t position;
+    std::vector<double, AlignedAllocator<double>> inputs;
+    std::vector<double, AlignedAllocator<double>> targets;
+
+public:
+    BatchSampler(const DatasetView& data, size_t batchSize, bool shuffle = true, Rng generator = rng::stream())
+    : data(data), batchSize(std::max<size_t>(batchSize, 1)), shuffle(shuffle), generator(generator),
+    indices(data.size()), position(0) {
+        std::iota(indices.begin(), indices.end(), 0);
+        inputs.resize(this->batchSize * data.inputSize());
+        targets.resize(this->batchSize * data.outputSize());
+    }
+
+    size_t inputSize() const override { return data.inputSize(); }
+    size_t outputSize() const override { return data.outputSize(); }
+    size_t batchesPerEpoch() const { return (data.size() + batchSize - 1) / batchSize; }
+
+    void rewind() override {
+        position = 0;
+        if (shuffle) {
+            generator.shuffle(indices.begin(), indices.end());
+        }
+    }
+
+    DatasetView next() override {
+        const size_t first = position;
+        const size_t n = std::min(batchSize, data.size() - first);
+        position += n;
+        if (!shuffle) {
+            return data.batch(first, n);
+        }
+        const size_t inputWidth = data.inputSize();
+        const size_t outputWidth = data.outputSize();
+        for (size_t b = 0; b < n; ++b) {
+            const std::span<const double> input = data.input(indices[first + b]);
+            const std::span<const double> target = data.target(indices[first + b]);
+            std::copy(input.begin(), input.end(), inputs.data() + b * inputWidth);
+            std::copy(target.begin(), target.end(), targets.data() + b * outputWidth);
+        }
+        return DatasetView(inputs.data(), targets.data(), n, inputWidth, outputWidth);
+    }
+};
+
+// Reads a BatchSource ahead on a background thread (see the top of the
+// file). The source belongs to the Prefetcher while it exists and must not
+// be used elsewhere. The producer moves on to the next epoch as soon as it
+// has finished one, so the first batches of an epoch are ready by the time
+// training asks for them; an epoch abandoned part way is drained by
+// rewind(). An exception thrown by the source or the augmentation is
+// rethrown by next().
+class Prefetcher : public BatchSource {
+public:
+    // Alters `count` samples in place, e.g. adding noise, using `generator`
+    // for any randomness so that a seed fixes the result
+    using Augment = std::function<void(size_t count, std::span<double> inputs, std::span<double> targets,
+                                       Rng& generator)>;
+
+private:
+    struct Slot {
+        std::vector<double, AlignedAllocator<double>> inputs;
+        std::vector<double, AlignedAllocator<double>> targets;
+        size_t count = 0;
+        // Marks the end of an epoch, or a failure, instead of a batch
+        bool endOfEpoch = false;
+        std::exception_ptr error;
+    };
+
+    BatchSource& source;
+    size_t inputWidth;
+    size_t outputWidth;
+    Augment augment;
+    Rng generator;
+    SpscRing<Slot> ring;
+    std::thread producer;
+
+    // Consumer state: a slot is held until the next call, and an epoch is
+    // fresh until its first batch is taken
+    bool holding = false;
+    bool atEnd = false;
+    bool fresh = true;
+    size_t waits = 0;
+
+    void run() {
+        try {
+            while (true) {
+                source.rewind();
+                bool more = true;
+                while (more) {
+                    Slot* slot = ring.reserve();
+                    if (!slot) return;
+                    const DatasetView batch = source.next();
+                    more = !batch.empty();
+                    slot->endOfEpoch = !more;
+                    slot->count = batch.size();
+                    slot->inputs.assign(batch.inputs().begin(), batch.inputs().end());
+                    slot->targets.assign(batch.targets().begin(), batch.targets().end());
+                    if (more && augment) {
+                        augment(slot->count, std::span<double>(slot->inputs), std::span<double>(slot->targets), generator);
+                    }
+                    ring.publish();
+                }
+            }
+        } catch (...) {
+            if (Slot* slot = ring.reserve()) {
+                slot->endOfEpoch = true;
+                slot->error = std::current_exception();
+                ring.publish();
+            }
+        }
+    }
+
+    void releaseHeld() {
+        if (holding) {
+            ring.release();
+            holding = false;
+        }
+    }
+
+public:
+    explicit Prefetcher(BatchSource& source, size_t depth = 2, Augment augment = nullptr,
+                        Rng generator = rng::stream())
+    : source(source), inputWidth(source.inputSize()), outputWidth(source.outputSize()),
+    augment(std::move(augment)), generator(generator), ring(depth) {
+        producer = std::thread([this] { run(); });
+    }
+
+    ~Prefetcher() {
+        ring.close();
+        producer.join();
+    }
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    size_t inputSize() const override { return inputWidth; }
+    size_t outputSize() const override { return outputWidth; }
+
+    // Number of next() calls that found no batch ready and had to wait for
+    // the producer; a count growing with every epoch calls for a deeper
+    // ring or a cheaper source
+    size_t stalls() const { return waits; }
+
+    void rewind() override {
+        releaseHeld();
+        if (!fresh) {
+            while (!atEnd) next();
+            releaseHeld();
+        }
+        atEnd = false;
+        fresh = true;
+    }
+
+    DatasetView next() override {
+        releaseHeld();
+        if (atEnd) return DatasetView();
+        if (!ring.ready()) ++waits;
+
+        Slot* slot = ring.front();
+        fresh = false;
+        if (slot->error) {
+            // Left in the ring, so every later call rethrows as well
+            std::rethrow_exception(slot->error);
+        }
+        holding = true;
+        if (slot->endOfEpoch) {
+            atEnd = true;
+            return DatasetView();
+        }
+        return DatasetView(slot->inputs.data(), slot->targets.data(), slot->count, inputWidth, outputWidth);
+    }
+};
+
+#endif /* pipeline_hpp */
@@ -11,6 +11,8 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include "neural_network.hpp"
+#include "static_network.hpp"
+#include "synthetic.hpp"
 #include <vector>
 #include <iostream>
 #include <cmath>
@@ -52,38 +54,57 @@ inline void SDL_RenderDrawCircle(SDL_Renderer* ren, int cx, int cy, int radius)
 class Problem {
 public:
     virtual ~Problem() = default;
-    virtual std::vector<std::vector<double>> getInputs() = 0;  // Made non-const
-    virtual std::vector<std::vector<double>> getOutputs() = 0; // Made non-const
+    // Training samples, stored contiguously. Generated on the first call
+    // and kept, so every later call returns the same data.
+    virtual const Dataset& getData() = 0;
     virtual std::vector<size_t> getArchitecture() const = 0;
     virtual double getLearningRate() const = 0;
     virtual double getEpochs() const = 0;
     virtual std::string getName() const = 0;
+    // Network engine for this problem. Defaults to the dynamically sized
+    // NeuralNetwork; problems with a fixed topology can return a
+    // StaticNeuralNetwork instead.
+    virtual std::unique_ptr<Network> createNetwork() const {
+        return std::make_unique<NeuralNetwork>(getArchitecture(), getLearningRate());
+    }
     virtual void renderPoints(SDL_Renderer* renderer, int x_off, int y_off, int canvas_w, int canvas_h) const {}
+
+protected:
+    // Step between the samples drawn, so that large data sets show at most
+    // about `limit` points
+    static size_t renderStride(size_t count, size_t limit = 1000) {
+        return std::max<size_t>(1, count / limit);
+    }
 };
 
 // XOR Problem
 class XORProblem : public Problem {
 private:
-    std::vector<std::vector<double>> inputs = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
-    std::vector<std::vector<double>> outputs = {{0}, {1}, {1}, {0}};
+    synthetic::Cache<synthetic::Xor> data;
     double learning_rate = 0.7;
     int epochs_per_draw = 10;
 
 public:
-    std::vector<std::vector<double>> getInputs() override { return inputs; }
-    std::vector<std::vector<double>> getOutputs() override { return outputs; }
+    // The four corners by default; more points are spread around them
+    XORProblem(size_t num_points = 4, double noise = 0.0) : data({.count = num_points, .noise = noise}) {}
+
+    const Dataset& getData() override { return data.data(); }
     std::vector<size_t> getArchitecture() const override { return {2, 8, 8, 1}; }
     double getLearningRate() const override { return learning_rate; }
     double getEpochs() const override { return epochs_per_draw; }
     std::string getName() const override { return "XOR Problem"; }
+    std::unique_ptr<Network> createNetwork() const override {
+        return std::make_unique<StaticNeuralNetwork<2, 8, 8, 1>>(learning_rate);
+    }
     
     void renderPoints(SDL_Renderer* renderer, int x_off, int y_off, int canvas_w, int canvas_h) const override {
         // Draw training points
-        for (size_t i = 0; i < inputs.size(); ++i) {
-            int x = static_cast<int>(inputs[i][0] * canvas_w) + x_off;
-            int y = static_cast<int>(inputs[i][1] * canvas_h) + y_off;
+        const Dataset& data = this->data.current();
+        for (size_t i = 0; i < data.size(); i += renderStride(data.size())) {
+            int x = static_cast<int>(data.input(i)[0] * canvas_w) + x_off;
+            int y = static_cast<int>(data.input(i)[1] * canvas_h) + y_off;
             
-            if (outputs[i][0] > 0.5) {
+            if (data.target(i)[0] > 0.5) {
                 SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255); // Green for 1
             } else {
                 SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Red for 0
@@ -98,42 +119,24 @@ public:
 // Circle Problem - classify points inside/outside a circle
 class CircleProblem : public Problem {
 private:
-    mutable std::vector<std::vector<double>> cached_inputs;
-    mutable std::vector<std::vector<double>> cached_outputs;
     double center_x = 0.5;
     double center_y = 0.5;
     double radius = 0.3;
-    int num_points = 100;
+    synthetic::Cache<synthetic::Circle> data;
     double learning_rate = 0.15;
     int epochs_per_draw = 10;
-    
-    void generateData() {
-        cached_inputs.clear();
-        cached_outputs.clear();
-        
-        // Generate training data
-        for (int i = 0; i < num_points; ++i) {
-            double x = static_cast<double>(rand()) / RAND_MAX;
-            double y = static_cast<double>(rand()) / RAND_MAX;
-            
-            cached_inputs.push_back({x, y});
-            
-            // Check if point is inside circle
-            double dist = sqrt((x - center_x) * (x - center_x) + (y - center_y) * (y - center_y));
-            cached_outputs.push_back({dist <= radius ? 1.0 : 0.0});
-        }
-    }
+
 public:
-    CircleProblem() { }
-    std::vector<std::vector<double>> getInputs() override {
-        generateData();
-        return cached_inputs;
-    }
-    std::vector<std::vector<double>> getOutputs() override { return cached_outputs; }
+    CircleProblem(size_t num_points = 100)
+    : data({.count = num_points, .centerX = center_x, .centerY = center_y, .radius = radius}) { }
+    const Dataset& getData() override { return data.data(); }
     std::vector<size_t> getArchitecture() const override { return {2, 8, 16, 8, 1}; }
     double getLearningRate() const override { return learning_rate; }
     double getEpochs() const override { return epochs_per_draw; }
     std::string getName() const override { return "Circle Classification"; }
+    std::unique_ptr<Network> createNetwork() const override {
+        return std::make_unique<StaticNeuralNetwork<2, 8, 16, 8, 1>>(learning_rate);
+    }
     
     void renderPoints(SDL_Renderer* renderer, int x_off, int y_off, int canvas_w, int canvas_h) const override {
         // Draw circle boundary
@@ -151,11 +154,12 @@ public:
         }
         
         // Draw some training points
-        for (size_t i = 0; i < std::min(cached_inputs.size(), size_t(50)); ++i) {
-            int x = static_cast<int>(cached_inputs[i][0] * canvas_w) + x_off;
-            int y = static_cast<int>(cached_inputs[i][1] * canvas_h) + y_off;
+        const Dataset& data = this->data.current();
+        for (size_t i = 0; i < data.size(); i += renderStride(data.size(), 50)) {
+            int x = static_cast<int>(data.input(i)[0] * canvas_w) + x_off;
+            int y = static_cast<int>(data.input(i)[1] * canvas_h) + y_off;
             
-            if (cached_outputs[i][0] > 0.5) {
+            if (data.target(i)[0] > 0.5) {
                 SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255); // Green for inside
             } else {
                 SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Red for outside
@@ -169,57 +173,32 @@ public:
 // Spiral Problem - classify points in two interleaved spirals
 class SpiralProblem : public Problem {
 private:
-    std::vector<std::vector<double>> cached_inputs;
-    std::vector<std::vector<double>> cached_outputs;
+    synthetic::Cache<synthetic::Spiral> data;
     double learning_rate = 0.35;
     int epochs_per_draw = 20;
-    int num_points = 200;
-    
-    void generateData() {
-        if (cached_inputs.size() != 0) {
-            return;
-        }
-        cached_inputs.clear();
-        cached_outputs.clear();
-        for (int i = 0; i < num_points; ++i) {
-            double t = static_cast<double>(i) / num_points * 4 * M_PI;
-            double r = t / (4 * M_PI);
-            
-            // First spiral
-            double x1 = 0.5 + r * cos(t) * 0.5;
-            double y1 = 0.5 + r * sin(t) * 0.5;
-            cached_inputs.push_back({x1, y1});
-            cached_outputs.push_back({1.0});
-            
-            // Second spiral (offset by π)
-            double x2 = 0.5 + r * cos(t + M_PI) * 0.5;
-            double y2 = 0.5 + r * sin(t + M_PI) * 0.5;
-            cached_inputs.push_back({x2, y2});
-            cached_outputs.push_back({0.0});
-        }
-    }
 
 public:
-    SpiralProblem() {
+    // num_points per spiral
+    SpiralProblem(size_t num_points = 200, double noise = 0.0) : data({.count = 2 * num_points, .noise = noise}) {
         
     }
     
-    std::vector<std::vector<double>> getInputs() override {
-        generateData();
-        return cached_inputs;
-    }
-    std::vector<std::vector<double>> getOutputs() override { return cached_outputs; }
+    const Dataset& getData() override { return data.data(); }
     std::vector<size_t> getArchitecture() const override { return {2, 8, 8, 1}; }
     double getLearningRate() const override { return learning_rate; }
     double getEpochs() const override { return epochs_per_draw; }
     std::string getName() const override { return "Spiral Classification"; }
+    std::unique_ptr<Network> createNetwork() const override {
+        return std::make_unique<StaticNeuralNetwork<2, 8, 8, 1>>(learning_rate);
+    }
     
     void renderPoints(SDL_Renderer* renderer, int x_off, int y_off, int canvas_w, int canvas_h) const override {
-        for (size_t i = 0; i < cached_inputs.size(); ++i) {
-            int x = static_cast<int>(cached_inputs[i][0] * canvas_w) + x_off;
-            int y = static_cast<int>(cached_inputs[i][1] * canvas_h) + y_off;
+        const Dataset& data = this->data.current();
+        for (size_t i = 0; i < data.size(); i += renderStride(data.size())) {
+            int x = static_cast<int>(data.input(i)[0] * canvas_w) + x_off;
+            int y = static_cast<int>(data.input(i)[1] * canvas_h) + y_off;
             
-            if (cached_outputs[i][0] > 0.5) {
+            if (data.target(i)[0] > 0.5) {
                 SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255); // Green
             } else {
                 SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Red
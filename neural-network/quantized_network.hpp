@@ -0,0 +1,505 @@
+//
+//  quantized_network.hpp
+//  neural-network
+//
+//  Int8 post-training quantization for inference.
+//
+//  Weights are quantized symmetrically per output row: w ~ scale_r * q with
+//  q in [-127, 127]. Layer inputs are quantized asymmetrically to uint8,
+//  x ~ s * (q - z), with s and z calibrated from the range each layer's
+//  input takes over a sample of real inputs (values outside it saturate).
+//  A layer output is then
+//
+//      y_r = scale_r * s * (sum_k qw_rk * qx_k - z * sum_k qw_rk) + b_r
+//
+//  where the integer dot product accumulates in int32 and z * sum_k qw_rk
+//  is precomputed per row. Biases and activations stay in float.
+//
+//  Each layer is an int8 GEMM over a block of samples, tiled several weight
+//  rows by four samples so every load feeds several products. It uses
+//  AVX-512 VNNI (vpdpbusd) when the CPU has it, and otherwise AVX2,
+//  widening both operands to int16 before vpmaddwd so the uint8 x int8
+//  products can't saturate. Rows are padded to 32 bytes with zero weights
+//  so the kernels need no tail loop.
+//
+//  evaluate() compares a quantized model with the network it came from:
+//  output error, agreement of the predicted class, throughput and memory.
+//
+
+#ifndef quantized_network_hpp
+#define quantized_network_hpp
+
+#include "neural_network.hpp"
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <span>
+#include <algorithm>
+#include <stdexcept>
+
+namespace quant {
+
+// Row padding, in int8 elements
+constexpr size_t ROW_ALIGN = 32;
+
+inline size_t paddedLength(size_t n) {
+    return (n + ROW_ALIGN - 1) / ROW_ALIGN * ROW_ALIGN;
+}
+
+// out (rows x count) = W (rows x n) * X^T, where X holds `count` samples
+// of n values one per row and n is a multiple of ROW_ALIGN. Covers rows
+// [r0, rows) and samples [s0, count), the part the SIMD tiles leave over.
+inline void gemmScalar(size_t rows, size_t n, const int8_t* w, const uint8_t* x, size_t count, int32_t* out,
+                       size_t r0 = 0, size_t s0 = 0) {
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t s = r < r0 ? s0 : 0; s < count; ++s) {
+            int32_t sum = 0;
+            for (size_t k = 0; k < n; ++k) {
+                sum += static_cast<int32_t>(x[s * n + k]) * static_cast<int32_t>(w[r * n + k]);
+            }
+            out[r * count + s] = sum;
+        }
+    }
+}
+
+#ifdef NN_GEMM_X86
+
+// The four horizontal sums of a, b, c, d
+__attribute__((target("avx2")))
+inline __m128i sum4Avx2(__m256i a, __m256i b, __m256i c, __m256i d) {
+    const __m256i ab = _mm256_hadd_epi32(a, b);
+    const __m256i cd = _mm256_hadd_epi32(c, d);
+    const __m256i abcd = _mm256_hadd_epi32(ab, cd);
+    return _mm_add_epi32(_mm256_castsi256_si128(abcd), _mm256_extracti128_si256(abcd, 1));
+}
+
+__attribute__((target("avx2")))
+inline __m256i load(const void* p) {
+    return _mm256_loadu_si256(static_cast<const __m256i*>(p));
+}
+
+// 16 int8 or uint8 values, sign- or zero-extended to int16
+__attribute__((target("avx2")))
+inline __m256i widen(const int8_t* p) {
+    return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+__attribute__((target("avx2")))
+inline __m256i widen(const uint8_t* p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+// 2 x 4 tiles: two weight rows against four samples. Products are widened
+// to int16 so vpmaddwd can't saturate. Accumulators are spelled out so
+// they stay in registers at any optimisation level.
+__attribute__((target("avx2")))
+inline void gemmAvx2(size_t rows, size_t n, const int8_t* w, const uint8_t* x, size_t count, int32_t* out) {
+    for (size_t r = 0; r + 2 <= rows; r += 2) {
+        const int8_t* w0 = w + r * n;
+        const int8_t* w1 = w0 + n;
+        for (size_t s = 0; s + 4 <= count; s += 4) {
+            const uint8_t* x0 = x + s * n;
+            __m256i c00 = _mm256_setzero_si256(), c01 = c00, c02 = c00, c03 = c00;
+            __m256i c10 = c00, c11 = c00, c12 = c00, c13 = c00;
+            for (size_t k = 0; k < n; k += 16) {
+                const __m256i a0 = widen(w0 + k);
+                const __m256i a1 = widen(w1 + k);
+                __m256i b = widen(x0 + k);
+                c00 = _mm256_add_epi32(c00, _mm256_madd_epi16(b, a0));
+                c10 = _mm256_add_epi32(c10, _mm256_madd_epi16(b, a1));
+                b = widen(x0 + n + k);
+                c01 = _mm256_add_epi32(c01, _mm256_madd_epi16(b, a0));
+                c11 = _mm256_add_epi32(c11, _mm256_madd_epi16(b, a1));
+                b = widen(x0 + 2 * n + k);
+                c02 = _mm256_add_epi32(c02, _mm256_madd_epi16(b, a0));
+                c12 = _mm256_add_epi32(c12, _mm256_madd_epi16(b, a1));
+                b = widen(x0 + 3 * n + k);
+                c03 = _mm256_add_epi32(c03, _mm256_madd_epi16(b, a0));
+                c13 = _mm256_add_epi32(c13, _mm256_madd_epi16(b, a1));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + r * count + s), sum4Avx2(c00, c01, c02, c03));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (r + 1) * count + s), sum4Avx2(c10, c11, c12, c13));
+        }
+    }
+    gemmScalar(rows, n, w, x, count, out, rows / 2 * 2, count / 4 * 4);
+}
+
+// vpdpbusd multiplies uint8 by int8 and accumulates straight into int32.
+// With AVX-512VL there are 32 vector registers, enough for 4 x 4 tiles.
+__attribute__((target("avx2,avx512vnni,avx512vl")))
+inline void gemmVnni(size_t rows, size_t n, const int8_t* w, const uint8_t* x, size_t count, int32_t* out) {
+    for (size_t r = 0; r + 4 <= rows; r += 4) {
+        const int8_t* w0 = w + r * n;
+        for (size_t s = 0; s + 4 <= count; s += 4) {
+            const uint8_t* x0 = x + s * n;
+            __m256i c00 = _mm256_setzero_si256(), c01 = c00, c02 = c00, c03 = c00;
+            __m256i c10 = c00, c11 = c00, c12 = c00, c13 = c00;
+            __m256i c20 = c00, c21 = c00, c22 = c00, c23 = c00;
+            __m256i c30 = c00, c31 = c00, c32 = c00, c33 = c00;
+            for (size_t k = 0; k < n; k += 32) {
+                const __m256i b0 = load(x0 + k);
+                const __m256i b1 = load(x0 + n + k);
+                const __m256i b2 = load(x0 + 2 * n + k);
+                const __m256i b3 = load(x0 + 3 * n + k);
+                __m256i a = load(w0 + k);
+                c00 = _mm256_dpbusd_epi32(c00, b0, a);
+                c01 = _mm256_dpbusd_epi32(c01, b1, a);
+                c02 = _mm256_dpbusd_epi32(c02, b2, a);
+                c03 = _mm256_dpbusd_epi32(c03, b3, a);
+                a = load(w0 + n + k);
+                c10 = _mm256_dpbusd_epi32(c10, b0, a);
+                c11 = _mm256_dpbusd_epi32(c11, b1, a);
+                c12 = _mm256_dpbusd_epi32(c12, b2, a);
+                c13 = _mm256_dpbusd_epi32(c13, b3, a);
+                a = load(w0 + 2 * n + k);
+                c20 = _mm256_dpbusd_epi32(c20, b0, a);
+                c21 = _mm256_dpbusd_epi32(c21, b1, a);
+                c22 = _mm256_dpbusd_epi32(c22, b2, a);
+                c23 = _mm256_dpbusd_epi32(c23, b3, a);
+                a = load(w0 + 3 * n + k);
+                c30 = _mm256_dpbusd_epi32(c30, b0, a);
+                c31 = _mm256_dpbusd_epi32(c31, b1, a);
+                c32 = _mm256_dpbusd_epi32(c32, b2, a);
+                c33 = _mm256_dpbusd_epi32(c33, b3, a);
+            }
+            int32_t* o = out + r * count + s;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o), sum4Avx2(c00, c01, c02, c03));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o + count), sum4Avx2(c10, c11, c12, c13));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o + 2 * count), sum4Avx2(c20, c21, c22, c23));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o + 3 * count), sum4Avx2(c30, c31, c32, c33));
+        }
+    }
+    gemmScalar(rows, n, w, x, count, out, rows / 4 * 4, count / 4 * 4);
+}
+
+#endif /* NN_GEMM_X86 */
+
+using GemmKernel = void (*)(size_t, size_t, const int8_t*, const uint8_t*, size_t, int32_t*);
+
+// Int8 kernel for the CPU, honouring kernels::setIsa
+inline GemmKernel gemmKernel() {
+#ifdef NN_GEMM_X86
+    if (kernels::activeIsa() >= kernels::Isa::AVX512 && __builtin_cpu_supports("avx512vnni")
+        && __builtin_cpu_supports("avx512vl")) {
+        return &gemmVnni;
+    }
+    if (kernels::activeIsa() >= kernels::Isa::AVX2) {
+        return &gemmAvx2;
+    }
+#endif
+    return [](size_t rows, size_t n, const int8_t* w, const uint8_t* x, size_t count, int32_t* out) {
+        gemmScalar(rows, n, w, x, count, out);
+    };
+}
+
+inline const char* gemmKernelName() {
+    const GemmKernel kernel = gemmKernel();
+#ifdef NN_GEMM_X86
+    if (kernel == &gemmVnni) return "AVX-512 VNNI";
+    if (kernel == &gemmAvx2) return "AVX2";
+#endif
+    return "scalar";
+}
+
+} // namespace quant
+
+// Inference-only network with int8 weights, built from a trained
+// BasicNeuralNetwork by quantize(). Offers the prediction half of the
+// Network API.
+class QuantizedNetwork {
+private:
+    struct Layer {
+        size_t rows;
+        size_t cols;
+        size_t stride;                  // cols rounded up to quant::ROW_ALIGN
+        std::vector<int8_t, AlignedAllocator<int8_t>> weights;
+        std::vector<float> scales;      // weight row scale * input scale
+        std::vector<int32_t> offsets;   // input zero point * row sum of weights
+        std::vector<float> biases;
+        float inputScale;
+        int32_t inputZero;
+        Activation activation;
+    };
+
+    std::vector<size_t> architecture;
+    std::vector<Layer> layers;
+
+    // Samples per block in predictBatch: each weight row is reused across
+    // the block while it is in L1
+    static constexpr size_t BLOCK = 64;
+
+    static Arena& scratchArena() {
+        thread_local Arena scratch;
+        return scratch;
+    }
+
+    static void quantizeInput(const Layer& layer, const float* x, uint8_t* q) {
+        const float inv = 1.0f / layer.inputScale;
+        for (size_t k = 0; k < layer.cols; ++k) {
+            const float v = std::nearbyint(x[k] * inv) + static_cast<float>(layer.inputZero);
+            q[k] = static_cast<uint8_t>(std::clamp(v, 0.0f, 255.0f));
+        }
+        std::fill(q + layer.cols, q + layer.stride, uint8_t(0));
+    }
+
+    // n samples through the network. `inputs` holds them one per row, and
+    // `outputs` receives one prediction per row.
+    void forward(const double* inputs, double* outputs, size_t n) const {
+        Arena& scratch = scratchArena();
+        Arena::Scope scope(scratch);
+        const quant::GemmKernel gemm = quant::gemmKernel();
+        const size_t width = *std::max_element(architecture.begin(), architecture.end());
+
+        // Activations are sample-major here (one sample per row), so each
+        // sample's input to a layer is contiguous for quantization
+        float* a = scratch.allocate<float>(n * width);
+        float* z = scratch.allocate<float>(n * width);
+        uint8_t* q = scratch.allocate<uint8_t>(n * quant::paddedLength(width));
+        int32_t* acc = scratch.allocate<int32_t>(n * width);
+        for (size_t k = 0; k < n * architecture.front(); ++k) {
+            a[k] = static_cast<float>(inputs[k]);
+        }
+
+        for (const Layer& layer : layers) {
+            for (size_t s = 0; s < n; ++s) {
+                quantizeInput(layer, a + s * layer.cols, q + s * layer.stride);
+            }
+            // z is neuron-major (one sample per column) for activation::forward
+            gemm(layer.rows, layer.stride, layer.weights.data(), q, n, acc);
+            for (size_t r = 0; r < layer.rows; ++r) {
+                for (size_t s = 0; s < n; ++s) {
+                    z[r * n + s] = layer.scales[r] * static_cast<float>(acc[r * n + s] - layer.offsets[r]) + layer.biases[r];
+                }
+            }
+            activation::forward<float>(layer.activation, z, z, layer.rows, n);
+            for (size_t r = 0; r < layer.rows; ++r) {
+                for (size_t s = 0; s < n; ++s) {
+                    a[s * layer.rows + r] = z[r * n + s];
+                }
+            }
+        }
+        for (size_t k = 0; k < n * architecture.back(); ++k) {
+            outputs[k] = a[k];
+        }
+    }
+
+public:
+    // Quantizes `network`, calibrating each layer's input range on
+    // `calibration` (a representative sample of real inputs, e.g. some of
+    // a Problem's training data)
+    template <typename T, typename Master>
+    static QuantizedNetwork quantize(const BasicNeuralNetwork<T, Master>& network,
+                                     const std::vector<std::vector<double>>& calibration) {
+        if (calibration.empty()) {
+            throw std::invalid_argument("Quantization needs calibration inputs");
+        }
+        QuantizedNetwork result;
+        result.architecture = network.getArchitecture();
+        const std::vector<size_t>& arch = result.architecture;
+        const size_t layerCount = arch.size() - 1;
+
+        // Range of every layer's input over the calibration set, from a
+        // double-precision forward pass that always includes 0
+        std::vector<double> low(layerCount, 0.0), high(layerCount, 0.0);
+        for (const std::vector<double>& sample : calibration) {
+            if (sample.size() != arch.front()) {
+                throw std::invalid_argument("Calibration inputs must match the network input layer");
+            }
+            std::vector<double> a = sample;
+            for (size_t i = 0; i < layerCount; ++i) {
+                for (double v : a) {
+                    low[i] = std::min(low[i], v);
+                    high[i] = std::max(high[i], v);
+                }
+                const auto& W = network.getWeights(i);
+                const auto& b = network.getBiases(i);
+                std::vector<double> z(arch[i + 1]);
+                for (size_t r = 0; r < z.size(); ++r) {
+                    double sum = static_cast<double>(b(r, 0));
+                    for (size_t k = 0; k < a.size(); ++k) {
+                        sum += static_cast<double>(W(r, k)) * a[k];
+                    }
+                    z[r] = sum;
+                }
+                activation::forward<double>(network.getActivations()[i], z.data(), z.data(), z.size(), 1);
+                a = std::move(z);
+            }
+        }
+
+        for (size_t i = 0; i < layerCount; ++i) {
+            const auto& W = network.getWeights(i);
+            const auto& b = network.getBiases(i);
+            Layer layer;
+            layer.rows = arch[i + 1];
+            layer.cols = arch[i];
+            layer.stride = quant::paddedLength(layer.cols);
+            layer.activation = network.getActivations()[i];
+            const double range = std::max(high[i] - low[i], 1e-12);
+            layer.inputScale = static_cast<float>(range / 255.0);
+            layer.inputZero = static_cast<int32_t>(std::lround(-low[i] / (range / 255.0)));
+
+            layer.weights.assign(layer.rows * layer.stride, 0);
+            for (size_t r = 0; r < layer.rows; ++r) {
+                double peak = 0.0;
+                for (size_t k = 0; k < layer.cols; ++k) {
+                    peak = std::max(peak, std::abs(static_cast<double>(W(r, k))));
+                }
+                const double scale = peak > 0.0 ? peak / 127.0 : 1.0;
+                int32_t rowSum = 0;
+                for (size_t k = 0; k < layer.cols; ++k) {
+                    const long v = std::lround(static_cast<double>(W(r, k)) / scale);
+                    const int8_t qw = static_cast<int8_t>(std::clamp(v, -127L, 127L));
+                    layer.weights[r * layer.stride + k] = qw;
+                    rowSum += qw;
+                }
+                layer.scales.push_back(static_cast<float>(scale) * layer.inputScale);
+                layer.offsets.push_back(layer.inputZero * rowSum);
+                layer.biases.push_back(static_cast<float>(b(r, 0)));
+            }
+            result.layers.push_back(std::move(layer));
+        }
+        return result;
+    }
+
+    std::vector<double> predict(const std::vector<double>& input) const {
+        std::vector<double> output(architecture.back());
+        predict(input, output);
+        return output;
+    }
+
+    // Allocation-free once the calling thread's scratch has warmed up
+    void predict(std::span<const double> input, std::span<double> output) const {
+        if (input.size() != architecture.front()) {
+            throw std::invalid_argument("Input size must match network input layer");
+        }
+        if (output.size() != architecture.back()) {
+            throw std::invalid_argument("Output size must match network output layer");
+        }
+        forward(input.data(), output.data(), 1);
+    }
+
+    // Samples stored one after another, as in Network::predictBatch. Blocks
+    // of samples run in parallel on the thread pool.
+    void predictBatch(std::span<const double> inputs, std::span<double> outputs) const {
+        const size_t inputSize = architecture.front();
+        const size_t outputSize = architecture.back();
+        const size_t count = inputs.size() / inputSize;
+        if (inputs.size() != count * inputSize || outputs.size() != count * outputSize) {
+            throw std::invalid_argument("Batch buffers must hold whole samples of the network input and output layers");
+        }
+        const size_t blocks = (count + BLOCK - 1) / BLOCK;
+        parallelFor(0, blocks, 1, [&](size_t lo, size_t hi) {
+            for (size_t block = lo; block < hi; ++block) {
+                const size_t first = block * BLOCK;
+                const size_t n = std::min(BLOCK, count - first);
+                forward(inputs.data() + first * inputSize, outputs.data() + first * outputSize, n);
+            }
+        });
+    }
+
+    const std::vector<size_t>& getArchitecture() const {
+        return architecture;
+    }
+
+    // Bytes of weights, scales, offsets and biases
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (const Layer& layer : layers) {
+            bytes += layer.weights.size() * sizeof(int8_t)
+                   + layer.scales.size() * sizeof(float)
+                   + layer.offsets.size() * sizeof(int32_t)
+                   + layer.biases.size() * sizeof(float);
+        }
+        return bytes;
+    }
+};
+
+namespace quant {
+
+// Quantized model against its reference, on one set of inputs
+struct Report {
+    double maxError = 0.0;          // largest absolute output difference
+    double meanError = 0.0;         // mean absolute output difference
+    double agreement = 0.0;         // fraction of samples with the same predicted class
+    double referenceRate = 0.0;     // samples per second, predictBatch
+    double quantizedRate = 0.0;
+    size_t referenceBytes = 0;
+    size_t quantizedBytes = 0;
+
+    std::string toString() const {
+        std::ostringstream oss;
+        oss << "max error " << maxError << ", mean error " << meanError
+            << ", class agreement " << agreement * 100 << "%, "
+            << referenceRate << " -> " << quantizedRate << " samples/s, "
+            << referenceBytes << " -> " << quantizedBytes << " bytes";
+        return oss.str();
+    }
+};
+
+// Predicted class: the largest output, or output > 0.5 for a single one
+inline size_t predictedClass(const double* output, size_t n) {
+    if (n == 1) return output[0] > 0.5 ? 1 : 0;
+    return static_cast<size_t>(std::max_element(output, output + n) - output);
+}
+
+// Samples per second of predict(inputs, outputs), timed over enough
+// repetitions to run for at least `minSeconds`
+template <typename F>
+inline double throughput(size_t count, F&& predict, double minSeconds = 0.05) {
+    using Clock = std::chrono::steady_clock;
+    predict();
+    size_t runs = 0;
+    const auto start = Clock::now();
+    double elapsed = 0.0;
+    do {
+        predict();
+        ++runs;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < minSeconds);
+    return static_cast<double>(runs * count) / elapsed;
+}
+
+template <typename T, typename Master>
+inline Report evaluate(const BasicNeuralNetwork<T, Master>& reference, const QuantizedNetwork& quantized,
+                       const std::vector<std::vector<double>>& inputs) {
+    const std::vector<size_t>& arch = reference.getArchitecture();
+    const size_t outputSize = arch.back();
+    std::vector<double> flat;
+    for (const std::vector<double>& input : inputs) {
+        flat.insert(flat.end(), input.begin(), input.end());
+    }
+    std::vector<double> expected(inputs.size() * outputSize), actual(inputs.size() * outputSize);
+
+    Report report;
+    report.referenceRate = throughput(inputs.size(), [&] { reference.predictBatch(flat, expected); });
+    report.quantizedRate = throughput(inputs.size(), [&] { quantized.predictBatch(flat, actual); });
+
+    size_t agree = 0;
+    for (size_t s = 0; s < inputs.size(); ++s) {
+        const double* e = expected.data() + s * outputSize;
+        const double* a = actual.data() + s * outputSize;
+        for (size_t k = 0; k < outputSize; ++k) {
+            const double error = std::abs(e[k] - a[k]);
+            report.maxError = std::max(report.maxError, error);
+            report.meanError += error;
+        }
+        agree += predictedClass(e, outputSize) == predictedClass(a, outputSize);
+    }
+    report.meanError /= static_cast<double>(std::max<size_t>(expected.size(), 1));
+    report.agreement = static_cast<double>(agree) / static_cast<double>(std::max<size_t>(inputs.size(), 1));
+
+    for (size_t i = 0; i + 1 < arch.size(); ++i) {
+        report.referenceBytes += (arch[i + 1] * arch[i] + arch[i + 1]) * sizeof(T);
+        if constexpr (!std::is_same_v<T, Master>) {
+            report.referenceBytes += (arch[i + 1] * arch[i] + arch[i + 1]) * sizeof(Master);
+        }
+    }
+    report.quantizedBytes = quantized.memoryBytes();
+    return report;
+}
+
+} // namespace quant
+
+#endif /* quantized_network_hpp */
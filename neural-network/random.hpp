@@ -0,0 +1,210 @@
+//
+//  random.hpp
+//  neural-network
+//
+//  Seedable random numbers for initialisation, shuffling and data
+//  generation.
+//
+//  Rng is Philox4x32-10, a counter-based generator: output block n of
+//  stream s under key k is a pure function of (n, s, k), so streams are
+//  independent by construction, creating one is free, and its state is
+//  three words: the key, the stream and the position in it. The context
+//  hands out streams from a process-wide seed: rng::stream() gives the
+//  next stream in sequence (networks and problems take one each when they
+//  are created), and rng::local() gives the calling thread its own. With
+//  the same seed and the same order of creation, every run draws the same
+//  numbers.
+//
+//  The seed comes from NN_SEED when it is set, and from std::random_device
+//  otherwise; rng::setSeed() replaces it and restarts the stream sequence.
+//
+
+#ifndef random_hpp
+#define random_hpp
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <atomic>
+#include <random>
+#include <limits>
+#include <utility>
+
+class Rng {
+public:
+    using result_type = uint32_t;
+
+    explicit Rng(uint64_t seed = 0, uint64_t stream = 0) : key(seed), stream(stream), block(0), used(4) {}
+
+    // Everything needed to carry on the sequence, e.g. from a checkpoint:
+    // the key, the stream and the number of 32-bit outputs drawn
+    struct State {
+        uint64_t key = 0;
+        uint64_t stream = 0;
+        uint64_t position = 0;
+
+        bool operator==(const State&) const = default;
+    };
+
+    explicit Rng(const State& state) : key(state.key), stream(state.stream), block(state.position / 4), used(4) {
+        if (state.position % 4 != 0) {
+            generate();
+            used = static_cast<unsigned>(state.position % 4);
+        }
+    }
+
+    State state() const {
+        return State{key, stream, block * 4 + used - 4};
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<uint32_t>::max(); }
+
+    result_type operator()() {
+        if (used == 4) {
+            generate();
+            used = 0;
+        }
+        return output[used++];
+    }
+
+    uint64_t next64() {
+        const uint64_t hi = (*this)();
+        return (hi << 32) | (*this)();
+    }
+
+    // Uniform in [0, 1) with 53 random bits
+    double uniform() {
+        return static_cast<double>(next64() >> 11) * 0x1.0p-53;
+    }
+
+    double uniform(double lo, double hi) {
+        return lo + (hi - lo) * uniform();
+    }
+
+    // Uniform in [0, n), without modulo bias (Lemire's method)
+    uint64_t below(uint64_t n) {
+        if (n <= std::numeric_limits<uint32_t>::max()) {
+            const uint32_t bound = static_cast<uint32_t>(n);
+            uint64_t m = static_cast<uint64_t>((*this)()) * bound;
+            if (static_cast<uint32_t>(m) < bound) {
+                const uint32_t threshold = static_cast<uint32_t>(-bound) % bound;
+                while (static_cast<uint32_t>(m) < threshold) {
+                    m = static_cast<uint64_t>((*this)()) * bound;
+                }
+            }
+            return m >> 32;
+        }
+        std::uniform_int_distribution<uint64_t> pick(0, n - 1);
+        return pick(*this);
+    }
+
+    // Fisher-Yates. Unlike std::shuffle the sequence is specified, so the
+    // same seed gives the same order with every standard library.
+    template <typename It>
+    void shuffle(It first, It last) {
+        const size_t n = static_cast<size_t>(last - first);
+        for (size_t i = n; i > 1; --i) {
+            using std::swap;
+            swap(first[i - 1], first[below(i)]);
+        }
+    }
+
+    // Independent stream `id` under the same seed
+    Rng split(uint64_t id) const {
+        return Rng(key, id);
+    }
+
+private:
+    uint64_t key;
+    uint64_t stream;
+    uint64_t block;
+    uint32_t output[4];
+    unsigned used;
+
+    static void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo) {
+        const uint64_t product = static_cast<uint64_t>(a) * b;
+        hi = static_cast<uint32_t>(product >> 32);
+        lo = static_cast<uint32_t>(product);
+    }
+
+    // Ten Philox rounds over the counter (block, stream)
+    void generate() {
+        uint32_t c[4] = {static_cast<uint32_t>(block), static_cast<uint32_t>(block >> 32),
+                         static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32)};
+        uint32_t k[2] = {static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32)};
+        for (int round = 0; round < 10; ++round) {
+            uint32_t hi0, lo0, hi1, lo1;
+            mulhilo(0xD2511F53u, c[0], hi0, lo0);
+            mulhilo(0xCD9E8D57u, c[2], hi1, lo1);
+            c[0] = hi1 ^ c[1] ^ k[0];
+            c[1] = lo1;
+            c[2] = hi0 ^ c[3] ^ k[1];
+            c[3] = lo0;
+            k[0] += 0x9E3779B9u;
+            k[1] += 0xBB67AE85u;
+        }
+        for (int i = 0; i < 4; ++i) {
+            output[i] = c[i];
+        }
+        ++block;
+    }
+};
+
+namespace rng {
+
+struct Context {
+    std::atomic<uint64_t> seed;
+    std::atomic<uint64_t> nextStream;
+    // Bumped by setSeed so thread-local streams know to restart
+    std::atomic<uint64_t> generation;
+
+    Context() : nextStream(0), generation(0) {
+        const char* env = std::getenv("NN_SEED");
+        if (env != nullptr) {
+            seed = std::strtoull(env, nullptr, 0);
+        } else {
+            std::random_device rd;
+            seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+        }
+    }
+};
+
+inline Context& context() {
+    static Context instance;
+    return instance;
+}
+
+inline uint64_t seed() {
+    return context().seed.load();
+}
+
+// Not thread-safe with respect to streams being handed out: seed before
+// creating networks and problems
+inline void setSeed(uint64_t s) {
+    Context& c = context();
+    c.seed = s;
+    c.nextStream = 0;
+    c.generation.fetch_add(1);
+}
+
+// The next stream in sequence
+inline Rng stream() {
+    Context& c = context();
+    return Rng(c.seed.load(), c.nextStream.fetch_add(1));
+}
+
+// The calling thread's stream, taken from the sequence on first use
+inline Rng& local() {
+    thread_local Rng generator;
+    thread_local uint64_t generation = ~uint64_t(0);
+    if (generation != context().generation.load()) {
+        generation = context().generation.load();
+        generator = stream();
+    }
+    return generator;
+}
+
+} // namespace rng
+
+#endif /* random_hpp */
@@ -0,0 +1,183 @@
+//
+//  static_matrix.hpp
+//  neural-network
+//
+
+#ifndef static_matrix_hpp
+#define static_matrix_hpp
+
+#include <vector>
+#include <span>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "random.hpp"
+
+// Calls f(std::integral_constant<size_t, I>{}) for I = 0 .. N-1. The calls
+// are expanded at compile time, so loops written with it are fully unrolled
+// even in unoptimised builds.
+template <size_t N, typename F>
+inline void staticFor(F&& f) {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (f(std::integral_constant<size_t, I>{}), ...);
+    }(std::make_index_sequence<N>{});
+}
+
+// Fixed-size row-major matrix with its storage inline, so it lives on the
+// stack (or inside its owner) and never touches the heap. Dimensions are
+// part of the type: a shape mismatch in any of the operations below is a
+// compile error rather than a runtime exception.
+template <size_t R, size_t C, typename T = double>
+class StaticMatrix {
+    static_assert(R > 0 && C > 0, "StaticMatrix dimensions must be positive");
+    static_assert(std::is_floating_point_v<T>, "Matrix scalar type must be floating point");
+
+private:
+    alignas(64) T values[R * C] = {};
+
+public:
+    using Scalar = T;
+
+    constexpr StaticMatrix() = default;
+
+    // Accessors
+    static constexpr size_t numRows() { return R; }
+    static constexpr size_t numCols() { return C; }
+    static constexpr size_t size() { return R * C; }
+
+    T* data() { return values; }
+    const T* data() const { return values; }
+
+    // Operator overloads
+    constexpr T& operator()(size_t row, size_t col) {
+        if (row >= R || col >= C) {
+            throw std::out_of_range("Matrix index out of range");
+        }
+        return values[row * C + col];
+    }
+    constexpr const T& operator()(size_t row, size_t col) const {
+        if (row >= R || col >= C) {
+            throw std::out_of_range("Matrix index out of range");
+        }
+        return values[row * C + col];
+    }
+
+    // Utility
+    // Uniform in [min, max), from the calling thread's stream by default
+    void randomize(T min = T(-1), T max = T(1), Rng& generator = rng::local()) {
+        for (T& value : values) {
+            value = static_cast<T>(generator.uniform(min, max));
+        }
+    }
+
+    // Copy a column of values in; the length is only known at run time
+    void load(std::span<const double> column) {
+        static_assert(C == 1, "Can only load a vector into a single-column matrix");
+        if (column.size() != R) {
+            throw std::invalid_argument("Vector length must match matrix rows");
+        }
+        staticFor<R>([&](auto i) { values[i] = static_cast<T>(column[i]); });
+    }
+
+    std::vector<double> toVector() const {
+        static_assert(C == 1, "Can only convert single-column matrix to vector");
+        return std::vector<double>(values, values + R);
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const StaticMatrix& matrix) {
+        for (size_t i = 0; i < R; ++i) {
+            os << "[";
+            for (size_t j = 0; j < C; ++j) {
+                os << std::fixed << std::setprecision(4) << matrix.values[i * C + j];
+                if (j < C - 1) os << ", ";
+            }
+            os << "]\n";
+        }
+        return os;
+    }
+};
+
+// Kernels used by StaticNeuralNetwork. Every loop has compile-time bounds
+// and is unrolled with staticFor.
+
+// out = W * x + b
+template <size_t R, size_t C, typename T>
+inline void multiplyAdd(StaticMatrix<R, 1, T>& out, const StaticMatrix<R, C, T>& W,
+                        const StaticMatrix<C, 1, T>& x, const StaticMatrix<R, 1, T>& b) {
+    const T* w = W.data();
+    const T* xv = x.data();
+    staticFor<R>([&](auto i) {
+        T sum = b.data()[i];
+        staticFor<C>([&](auto j) { sum += w[i * C + j] * xv[j]; });
+        out.data()[i] = sum;
+    });
+}
+
+// out = W^T * d
+template <size_t R, size_t C, typename T>
+inline void multiplyTransposed(StaticMatrix<C, 1, T>& out, const StaticMatrix<R, C, T>& W,
+                               const StaticMatrix<R, 1, T>& d) {
+    const T* w = W.data();
+    T* o = out.data();
+    staticFor<C>([&](auto j) { o[j] = T(0); });
+    staticFor<R>([&](auto i) {
+        const T di = d.data()[i];
+        staticFor<C>([&](auto j) { o[j] += w[i * C + j] * di; });
+    });
+}
+
+// W += alpha * d * a^T
+template <size_t R, size_t C, typename T>
+inline void rank1Update(StaticMatrix<R, C, T>& W, T alpha,
+                        const StaticMatrix<R, 1, T>& d, const StaticMatrix<C, 1, T>& a) {
+    T* w = W.data();
+    const T* av = a.data();
+    staticFor<R>([&](auto i) {
+        const T s = alpha * d.data()[i];
+        staticFor<C>([&](auto j) { w[i * C + j] += s * av[j]; });
+    });
+}
+
+// y += alpha * x
+template <size_t R, size_t C, typename T>
+inline void axpy(StaticMatrix<R, C, T>& y, T alpha, const StaticMatrix<R, C, T>& x) {
+    staticFor<R * C>([&](auto k) { y.data()[k] += alpha * x.data()[k]; });
+}
+
+// Operator overloads
+template <size_t R, size_t K, size_t C, typename T>
+inline StaticMatrix<R, C, T> operator*(const StaticMatrix<R, K, T>& lhs, const StaticMatrix<K, C, T>& rhs) {
+    StaticMatrix<R, C, T> result;
+    staticFor<R>([&](auto i) {
+        staticFor<K>([&](auto k) {
+            const T a = lhs.data()[i * K + k];
+            staticFor<C>([&](auto j) { result.data()[i * C + j] += a * rhs.data()[k * C + j]; });
+        });
+    });
+    return result;
+}
+
+template <size_t R, size_t C, typename T>
+inline StaticMatrix<R, C, T> operator+(const StaticMatrix<R, C, T>& lhs, const StaticMatrix<R, C, T>& rhs) {
+    StaticMatrix<R, C, T> result;
+    staticFor<R * C>([&](auto k) { result.data()[k] = lhs.data()[k] + rhs.data()[k]; });
+    return result;
+}
+
+template <size_t R, size_t C, typename T>
+inline StaticMatrix<R, C, T> operator-(const StaticMatrix<R, C, T>& lhs, const StaticMatrix<R, C, T>& rhs) {
+    StaticMatrix<R, C, T> result;
+    staticFor<R * C>([&](auto k) { result.data()[k] = lhs.data()[k] - rhs.data()[k]; });
+    return result;
+}
+
+template <size_t R, size_t C, typename T>
+inline StaticMatrix<R, C, T> hadamard(const StaticMatrix<R, C, T>& lhs, const StaticMatrix<R, C, T>& rhs) {
+    StaticMatrix<R, C, T> result;
+    staticFor<R * C>([&](auto k) { result.data()[k] = lhs.data()[k] * rhs.data()[k]; });
+    return result;
+}
+
+#endif /* static_matrix_hpp */
@@ -0,0 +1,304 @@
+//
+//  static_network.hpp
+//  neural-network
+//
+
+#ifndef static_network_hpp
+#define static_network_hpp
+
+#include "static_matrix.hpp"
+#include "network_base.hpp"
+#include <array>
+#include <tuple>
+#include <cmath>
+#include <type_traits>
+
+// Sigmoid network whose topology is fixed at compile time, e.g.
+// StaticNeuralNetwork<2, 8, 8, 1>. Weights and biases are StaticMatrix
+// members and the per-step activations and deltas are locals, so neither
+// predict nor trainSingle allocates, and every loop is unrolled. Offers the
+// same API as NeuralNetwork through the Network interface.
+template <size_t... Layers>
+class StaticNeuralNetwork final : public NetworkBase<StaticNeuralNetwork<Layers...>> {
+    static_assert(sizeof...(Layers) >= 2, "Neural network must have at least input and output layers");
+    static_assert(((Layers > 0) && ...), "Layer sizes must be positive");
+
+public:
+    static constexpr std::array<size_t, sizeof...(Layers)> layers = {Layers...};
+    static constexpr size_t numWeightLayers = sizeof...(Layers) - 1;
+    static constexpr size_t inputSize = layers.front();
+    static constexpr size_t outputSize = layers.back();
+
+private:
+    using Base = NetworkBase<StaticNeuralNetwork<Layers...>>;
+    using Base::optimizer;
+
+    template <size_t I> using Weight = StaticMatrix<layers[I + 1], layers[I]>;
+    template <size_t I> using Column = StaticMatrix<layers[I], 1>;
+
+    template <size_t... I>
+    static std::tuple<Weight<I>...> weightTuple(std::index_sequence<I...>);
+    template <size_t... I>
+    static std::tuple<Column<I + 1>...> biasTuple(std::index_sequence<I...>);
+    template <size_t... I>
+    static std::tuple<Column<I>...> activationTuple(std::index_sequence<I...>);
+
+    // weights[i] maps layer i to layer i + 1; biases and deltas are indexed
+    // the same way. Activations hold the input plus every layer output.
+    using Weights = decltype(weightTuple(std::make_index_sequence<numWeightLayers>{}));
+    using Biases = decltype(biasTuple(std::make_index_sequence<numWeightLayers>{}));
+    using Activations = decltype(activationTuple(std::make_index_sequence<numWeightLayers + 1>{}));
+    using Deltas = Biases;
+
+    Weights weights;
+    Biases biases;
+    // Optimizer state (velocity, or first and second moments), zero until
+    // the first step
+    Weights weightState[2];
+    Biases biasState[2];
+
+    static double sigmoid(double x) {
+        return 1.0 / (1.0 + std::exp(-x));
+    }
+
+    void forwardPropagate(Activations& activations) const {
+        staticFor<numWeightLayers>([&](auto i) {
+            auto& out = std::get<i + 1>(activations);
+            multiplyAdd(out, std::get<i>(weights), std::get<i>(activations), std::get<i>(biases));
+            staticFor<std::remove_reference_t<decltype(out)>::size()>([&](auto k) { out.data()[k] = sigmoid(out.data()[k]); });
+        });
+    }
+
+    // d *= sigmoid'(z), written in terms of the layer output a = sigmoid(z)
+    template <size_t N>
+    static void scaleBySigmoidDerivative(StaticMatrix<N, 1>& d, const StaticMatrix<N, 1>& a) {
+        staticFor<N>([&](auto k) {
+            const double s = a.data()[k];
+            d.data()[k] *= s * (1.0 - s);
+        });
+    }
+
+    // Forward pass for one sample, then the deltas of every layer. Returns
+    // the sample's squared output error.
+    double backpropagate(std::span<const double> input, std::span<const double> target,
+                         Activations& activations, Deltas& deltas) const {
+        if (input.size() != inputSize || target.size() != outputSize) {
+            throw std::invalid_argument("Sample size must match network layer");
+        }
+
+        // Forward propagation
+        std::get<0>(activations).load(input);
+        forwardPropagate(activations);
+
+        // Calculate output layer delta (error * sigmoid derivative)
+        constexpr size_t last = numWeightLayers - 1;
+        auto& output = std::get<last + 1>(activations);
+        auto& outputDelta = std::get<last>(deltas);
+        double squaredError = 0.0;
+        staticFor<outputSize>([&](auto k) {
+            outputDelta.data()[k] = output.data()[k] - target[k];
+            squaredError += outputDelta.data()[k] * outputDelta.data()[k];
+        });
+        scaleBySigmoidDerivative(outputDelta, output);
+
+        // Calculate hidden layer deltas (backpropagate): W^T * delta
+        staticFor<numWeightLayers - 1>([&](auto step) {
+            constexpr size_t i = last - 1 - decltype(step)::value;
+            multiplyTransposed(std::get<i>(deltas), std::get<i + 1>(weights), std::get<i + 1>(deltas));
+            scaleBySigmoidDerivative(std::get<i>(deltas), std::get<i + 1>(activations));
+        });
+        return squaredError;
+    }
+
+    // One optimizer step from summed gradients, scaled by gradScale
+    void applyUpdate(const optim::StepCoefficients& c, const Weights& weightGrads,
+                     const Biases& biasGrads, double gradScale) {
+        staticFor<numWeightLayers>([&](auto i) {
+            auto& w = std::get<i>(weights);
+            auto& b = std::get<i>(biases);
+            optim::update(optimizer, c, w.size(), w.data(), std::get<i>(weightGrads).data(), gradScale,
+                          std::get<i>(weightState[0]).data(), std::get<i>(weightState[1]).data());
+            optim::update(optimizer, c, b.size(), b.data(), std::get<i>(biasGrads).data(), gradScale,
+                          std::get<i>(biasState[0]).data(), std::get<i>(biasState[1]).data(),
+                          static_cast<double*>(nullptr), false);
+        });
+    }
+
+    // Called by NetworkBase::setOptimizer
+    void resetOptimizerState() {
+        for (size_t s = 0; s < 2; ++s) {
+            weightState[s] = Weights();
+            biasState[s] = Biases();
+        }
+    }
+    friend Base;
+
+    // One update on `count` samples (see NetworkBase). A single sample
+    // updates straight from its deltas; a batch accumulates every sample's
+    // gradient into a weight-shaped local, then applies their average in
+    // one update.
+    template <typename Input, typename Target>
+    void trainSamples(size_t count, Input input, Target target) {
+        if (count == 0) return;
+        if (count == 1) {
+            Activations activations;
+            Deltas deltas;
+            Base::addLoss(backpropagate(input(0), target(0), activations, deltas), 1);
+
+            // Update weights and biases
+            const optim::StepCoefficients c = Base::nextStep();
+            if (optimizer.method == optim::Method::SGD) {
+                staticFor<numWeightLayers>([&](auto i) {
+                    rank1Update(std::get<i>(weights), -c.rate, std::get<i>(deltas), std::get<i>(activations));
+                    axpy(std::get<i>(biases), -c.rate, std::get<i>(deltas));
+                });
+            } else {
+                // The bias gradient is the delta itself
+                Weights weightGrads;
+                staticFor<numWeightLayers>([&](auto i) {
+                    rank1Update(std::get<i>(weightGrads), 1.0, std::get<i>(deltas), std::get<i>(activations));
+                });
+                applyUpdate(c, weightGrads, deltas, 1.0);
+            }
+            return;
+        }
+
+        Weights weightGrads;
+        Biases biasGrads;
+        double squaredError = 0.0;
+        for (size_t b = 0; b < count; ++b) {
+            Activations activations;
+            Deltas deltas;
+            squaredError += backpropagate(input(b), target(b), activations, deltas);
+            staticFor<numWeightLayers>([&](auto i) {
+                rank1Update(std::get<i>(weightGrads), 1.0, std::get<i>(deltas), std::get<i>(activations));
+                axpy(std::get<i>(biasGrads), 1.0, std::get<i>(deltas));
+            });
+        }
+
+        Base::addLoss(squaredError, count);
+        applyUpdate(Base::nextStep(), weightGrads, biasGrads, 1.0 / static_cast<double>(count));
+    }
+
+public:
+    StaticNeuralNetwork(double lr = 0.5) : Base(std::vector<size_t>(layers.begin(), layers.end()), lr) {
+        staticFor<numWeightLayers>([&](auto i) {
+            std::get<i>(weights).randomize(-2.0, 2.0, this->generator);
+            std::get<i>(biases).randomize(-1.0, 1.0, this->generator);
+        });
+    }
+
+    // Prediction methods
+    std::vector<double> predict(const std::vector<double>& input) const override {
+        if (input.size() != inputSize) {
+            throw std::invalid_argument("Input size must match network input layer");
+        }
+        Activations activations;
+        std::get<0>(activations).load(input);
+        forwardPropagate(activations);
+        return std::get<numWeightLayers>(activations).toVector();
+    }
+
+    // Activations live on the stack, so this never allocates
+    void predict(std::span<const double> input, std::span<double> output) const override {
+        if (input.size() != inputSize) {
+            throw std::invalid_argument("Input size must match network input layer");
+        }
+        if (output.size() != outputSize) {
+            throw std::invalid_argument("Output size must match network output layer");
+        }
+        Activations activations;
+        staticFor<inputSize>([&](auto k) { std::get<0>(activations).data()[k] = input[k]; });
+        forwardPropagate(activations);
+        staticFor<outputSize>([&](auto k) { output[k] = std::get<numWeightLayers>(activations).data()[k]; });
+    }
+
+    // Fixed-size form: the input shape is checked at compile time. Named
+    // apart from predict so that predict({x, y}) still means the vector
+    // overload, as on every other Network.
+    std::array<double, outputSize> predictFixed(const std::array<double, inputSize>& input) const {
+        Activations activations;
+        staticFor<inputSize>([&](auto k) { std::get<0>(activations).data()[k] = input[k]; });
+        forwardPropagate(activations);
+        std::array<double, outputSize> output;
+        staticFor<outputSize>([&](auto k) { output[k] = std::get<numWeightLayers>(activations).data()[k]; });
+        return output;
+    }
+
+    // Samples go through one at a time: each is already allocation-free and
+    // fully unrolled, so there is nothing for batching to amortise
+    void predictBatch(std::span<const double> inputs, std::span<double> outputs) const override {
+        const size_t count = Base::batchCount(inputs, outputs);
+        for (size_t n = 0; n < count; ++n) {
+            Activations activations;
+            staticFor<inputSize>([&](auto k) { std::get<0>(activations).data()[k] = inputs[n * inputSize + k]; });
+            forwardPropagate(activations);
+            staticFor<outputSize>([&](auto k) {
+                outputs[n * outputSize + k] = std::get<numWeightLayers>(activations).data()[k];
+            });
+        }
+    }
+    using Base::predictBatch;
+
+    // Buffers: every layer's weights and biases, then both optimizer state
+    // buffers of each, the same way round
+    TrainingState captureState() const override {
+        TrainingState state = Base::captureBase();
+        auto add = [&](const auto& m) {
+            state.buffers.emplace_back(m.data(), m.data() + m.size());
+        };
+        staticFor<numWeightLayers>([&](auto i) {
+            add(std::get<i>(weights));
+            add(std::get<i>(biases));
+        });
+        for (size_t s = 0; s < 2; ++s) {
+            staticFor<numWeightLayers>([&](auto i) {
+                add(std::get<i>(weightState[s]));
+                add(std::get<i>(biasState[s]));
+            });
+        }
+        return state;
+    }
+
+    void restoreState(const TrainingState& state) override {
+        // Buffers in captureState() order; every shape is fixed
+        std::vector<size_t> sizes;
+        for (size_t s = 0; s < 3; ++s) {
+            staticFor<numWeightLayers>([&](auto i) {
+                sizes.push_back(std::get<i>(weights).size());
+                sizes.push_back(std::get<i>(biases).size());
+            });
+        }
+        Base::restoreBase(state, sizes);
+        size_t next = 0;
+        auto load = [&](auto& m) {
+            const std::vector<double>& values = state.buffers[next++];
+            std::copy(values.begin(), values.end(), m.data());
+        };
+        staticFor<numWeightLayers>([&](auto i) {
+            load(std::get<i>(weights));
+            load(std::get<i>(biases));
+        });
+        for (size_t s = 0; s < 2; ++s) {
+            staticFor<numWeightLayers>([&](auto i) {
+                load(std::get<i>(weightState[s]));
+                load(std::get<i>(biasState[s]));
+            });
+        }
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const StaticNeuralNetwork& network) {
+        os << "Neural Network:" << std::endl;
+        os << "  " << network.toString() << std::endl;
+
+        os << "  Weights:" << std::endl;
+        staticFor<numWeightLayers>([&](auto i) {
+            os << "    Layer " << i << " to Layer " << i + 1 << ":" << std::endl;
+            os << std::get<i>(network.weights) << std::endl;
+        });
+
+        return os;
+    }
+};
+
+#endif /* static_network_hpp */
@@ -0,0 +1,182 @@
+//
+//  synthetic.hpp
+//  neural-network
+//
+//  Generators for the toy data sets the Problems train on (XOR, a circle,
+//  two spirals), at any size. Samples are written straight into a
+//  Dataset's contiguous buffers, in fixed blocks spread over the thread
+//  pool. Each block draws from its own Philox stream, keyed by the seed
+//  and the block number, so the data depends on the parameters alone and
+//  not on the thread count or the order blocks run in.
+//
+//  A Cache holds the data for one set of parameters and regenerates it
+//  only when they change:
+//
+//      synthetic::Cache<synthetic::Circle> circle({.count = 20'000'000});
+//      network.train(circle.data(), 1, true, 256);
+//
+
+#ifndef synthetic_hpp
+#define synthetic_hpp
+
+#include "dataset.hpp"
+#include "random.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <numbers>
+#include <algorithm>
+
+namespace synthetic {
+
+// Samples per block; also the most a single task generates
+constexpr size_t BLOCK = 8192;
+
+// Distinct keys for each generator under the same seed, so that no
+// generator's streams overlap another's or those of rng::stream()
+inline uint64_t key(uint64_t seed, uint64_t salt) {
+    uint64_t z = seed + salt * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Resizes `data` to `count` samples of 2 inputs and 1 output and calls
+// sample(i, generator, x, y) -> label for each, block by block in parallel
+template <typename Sample>
+inline void fill(Dataset& data, size_t count, uint64_t streamKey, Sample sample) {
+    if (data.inputSize() != 2 || data.outputSize() != 1) {
+        data = Dataset(2, 1);
+    }
+    data.resize(count);
+    if (count == 0) return;
+    double* inputs = data.input(0).data();
+    double* targets = data.target(0).data();
+
+    const size_t blocks = (count + BLOCK - 1) / BLOCK;
+    ThreadPool::instance().parallelFor(0, blocks, 1, [&](size_t lo, size_t hi) {
+        for (size_t block = lo; block < hi; ++block) {
+            Rng generator(streamKey, block);
+            const size_t end = std::min(count, (block + 1) * BLOCK);
+            for (size_t i = block * BLOCK; i < end; ++i) {
+                targets[i] = sample(i, generator, inputs[2 * i], inputs[2 * i + 1]);
+            }
+        }
+    });
+}
+
+// The four corners of the unit square, cycled through in order, labelled
+// 1 where exactly one coordinate is 1. `noise` jitters each coordinate
+// uniformly by up to that much. The defaults give the classic four points.
+struct Xor {
+    size_t count = 4;
+    double noise = 0.0;
+    uint64_t seed = rng::seed();
+
+    bool operator==(const Xor&) const = default;
+};
+
+inline void generate(const Xor& p, Dataset& data) {
+    fill(data, p.count, key(p.seed, 1), [&](size_t i, Rng& generator, double& x, double& y) {
+        const size_t a = (i >> 1) & 1;
+        const size_t b = i & 1;
+        x = static_cast<double>(a);
+        y = static_cast<double>(b);
+        if (p.noise > 0.0) {
+            x += generator.uniform(-p.noise, p.noise);
+            y += generator.uniform(-p.noise, p.noise);
+        }
+        return static_cast<double>(a ^ b);
+    });
+}
+
+// Points uniform in the unit square, labelled 1 inside the circle
+struct Circle {
+    size_t count = 100;
+    double centerX = 0.5;
+    double centerY = 0.5;
+    double radius = 0.3;
+    uint64_t seed = rng::seed();
+
+    bool operator==(const Circle&) const = default;
+};
+
+inline void generate(const Circle& p, Dataset& data) {
+    const double radiusSquared = p.radius * p.radius;
+    fill(data, p.count, key(p.seed, 2), [&](size_t, Rng& generator, double& x, double& y) {
+        x = generator.uniform();
+        y = generator.uniform();
+        const double dx = x - p.centerX;
+        const double dy = y - p.centerY;
+        return dx * dx + dy * dy <= radiusSquared ? 1.0 : 0.0;
+    });
+}
+
+// Two interleaved spirals of two turns each, one labelled 1 and the
+// other, half a turn behind, labelled 0. Even samples are on the first
+// spiral and odd ones on the second, evenly spaced along them. `noise`
+// jitters each coordinate uniformly by up to that much.
+struct Spiral {
+    size_t count = 400;
+    double noise = 0.0;
+    uint64_t seed = rng::seed();
+
+    bool operator==(const Spiral&) const = default;
+};
+
+inline void generate(const Spiral& p, Dataset& data) {
+    const size_t perSpiral = (p.count + 1) / 2;
+    fill(data, p.count, key(p.seed, 3), [&](size_t i, Rng& generator, double& x, double& y) {
+        const double t = static_cast<double>(i / 2) / static_cast<double>(perSpiral) * 4 * std::numbers::pi;
+        const double r = t / (4 * std::numbers::pi);
+        const double angle = (i & 1) ? t + std::numbers::pi : t;
+        x = 0.5 + r * std::cos(angle) * 0.5;
+        y = 0.5 + r * std::sin(angle) * 0.5;
+        if (p.noise > 0.0) {
+            x += generator.uniform(-p.noise, p.noise);
+            y += generator.uniform(-p.noise, p.noise);
+        }
+        return (i & 1) ? 0.0 : 1.0;
+    });
+}
+
+// The data for one set of parameters, generated on first use and kept
+// until the parameters change
+template <typename Params>
+class Cache {
+private:
+    Params params;
+    Dataset samples = Dataset(2, 1);
+    bool stale = true;
+
+public:
+    explicit Cache(const Params& params = Params()) : params(params) {}
+
+    const Params& parameters() const { return params; }
+
+    void setParameters(const Params& p) {
+        if (!(p == params)) {
+            params = p;
+            stale = true;
+        }
+    }
+
+    const Dataset& data() {
+        if (stale) {
+            generate(params, samples);
+            stale = false;
+        }
+        return samples;
+    }
+
+    // The data as last generated, without generating it; empty before
+    // the first data() call
+    const Dataset& current() const {
+        return samples;
+    }
+};
+
+} // namespace synthetic
+
+#endif /* synthetic_hpp */
@@ -0,0 +1,262 @@
+//
+//  thread_pool.hpp
+//  neural-network
+//
+
+#ifndef thread_pool_hpp
+#define thread_pool_hpp
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
+#include <type_traits>
+
+// Process-wide work-stealing thread pool used by the Matrix kernels.
+//
+// Each worker owns a deque: it pops its own work from the back and, when
+// that runs dry, steals from the front of the other workers' deques. The
+// thread that calls parallelFor takes part in the work rather than blocking,
+// so a pool of N threads means N - 1 workers plus the caller. With a thread
+// count of 1 there are no workers and every parallelFor runs inline, which
+// gives fully deterministic, single-threaded execution.
+//
+// The thread count defaults to std::thread::hardware_concurrency() and can
+// be overridden with the NN_NUM_THREADS environment variable or
+// setThreadCount().
+class ThreadPool {
+public:
+    // Type-erased unit of work; no allocation per task
+    struct Task {
+        void (*run)(void*);
+        void* arg;
+    };
+
+    static ThreadPool& instance() {
+        static ThreadPool pool(defaultThreadCount());
+        return pool;
+    }
+
+    explicit ThreadPool(size_t threads) {
+        start(threads);
+    }
+
+    ~ThreadPool() {
+        stop();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads work is spread over, counting the caller
+    size_t threadCount() const {
+        return workers.size() + 1;
+    }
+
+    // Must not be called while parallel work is in flight
+    void setThreadCount(size_t threads) {
+        threads = std::max<size_t>(threads, 1);
+        if (threads == threadCount()) return;
+        stop();
+        start(threads);
+    }
+
+    // True on one of this pool's worker threads
+    static bool onWorkerThread() {
+        return workerIndex() != NO_WORKER;
+    }
+
+    // Calls f(chunkBegin, chunkEnd) over [begin, end) split into chunks of
+    // at least `grain` elements, and returns once every chunk is done. Runs
+    // inline when the range is a single chunk, the pool has one thread, or
+    // the caller is itself a worker (nested parallelism is serialised).
+    template <typename F>
+    void parallelFor(size_t begin, size_t end, size_t grain, F&& f) {
+        if (end <= begin) return;
+        grain = std::max<size_t>(grain, 1);
+        const size_t n = end - begin;
+        const size_t maxChunks = (n + grain - 1) / grain;
+        if (workers.empty() || maxChunks <= 1 || onWorkerThread()) {
+            f(begin, end);
+            return;
+        }
+
+        // A few chunks per thread so stealing can even out the load
+        const size_t chunks = std::min(maxChunks, threadCount() * 4);
+        const size_t chunkSize = (n + chunks - 1) / chunks;
+
+        using Fn = std::remove_reference_t<F>;
+        struct Job {
+            Fn* f;
+            size_t begin;
+            size_t end;
+            size_t chunkSize;
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> outstanding{0};
+
+            void drain() {
+                for (;;) {
+                    const size_t c = next.fetch_add(1, std::memory_order_relaxed);
+                    const size_t lo = begin + c * chunkSize;
+                    if (lo >= end) return;
+                    (*f)(lo, std::min(lo + chunkSize, end));
+                }
+            }
+            static void run(void* arg) {
+                Job* job = static_cast<Job*>(arg);
+                job->drain();
+                job->outstanding.fetch_sub(1, std::memory_order_release);
+            }
+        } job;
+        job.f = &f;
+        job.begin = begin;
+        job.end = end;
+        job.chunkSize = chunkSize;
+
+        const size_t helpers = std::min(workers.size(), chunks - 1);
+        job.outstanding.store(helpers, std::memory_order_relaxed);
+        for (size_t i = 0; i < helpers; ++i) {
+            push(i, Task{&Job::run, &job});
+        }
+
+        job.drain();
+
+        // The job lives on this stack frame, so wait for every helper task
+        // to finish, running queued work rather than idling
+        while (job.outstanding.load(std::memory_order_acquire) != 0) {
+            Task task;
+            if (steal(NO_WORKER, task)) {
+                task.run(task.arg);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    static constexpr size_t NO_WORKER = static_cast<size_t>(-1);
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued{0};
+    bool stopping = false;
+
+    static size_t defaultThreadCount() {
+        if (const char* env = std::getenv("NN_NUM_THREADS")) {
+            const long n = std::strtol(env, nullptr, 10);
+            if (n > 0) return static_cast<size_t>(n);
+        }
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    static size_t& workerIndex() {
+        thread_local size_t index = NO_WORKER;
+        return index;
+    }
+
+    void start(size_t threads) {
+        stopping = false;
+        const size_t count = std::max<size_t>(threads, 1) - 1;
+        queues.clear();
+        for (size_t i = 0; i < count; ++i) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < count; ++i) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+    }
+
+    void push(size_t worker, Task task) {
+        // Count the task before publishing it so the counter never dips
+        // below the number of queued tasks
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queued.fetch_add(1, std::memory_order_relaxed);
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+            queues[worker]->tasks.push_back(task);
+        }
+        wake.notify_one();
+    }
+
+    bool popOwn(size_t self, Task& task) {
+        Queue& q = *queues[self];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        task = q.tasks.back();
+        q.tasks.pop_back();
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool steal(size_t self, Task& task) {
+        const size_t n = queues.size();
+        const size_t first = self == NO_WORKER ? 0 : self + 1;
+        for (size_t i = 0; i < n; ++i) {
+            const size_t victim = (first + i) % n;
+            if (victim == self) continue;
+            Queue& q = *queues[victim];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            task = q.tasks.front();
+            q.tasks.pop_front();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(size_t self) {
+        workerIndex() = self;
+        for (;;) {
+            Task task;
+            if (popOwn(self, task) || steal(self, task)) {
+                task.run(task.arg);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] {
+                return stopping || queued.load(std::memory_order_relaxed) != 0;
+            });
+            if (stopping && queued.load(std::memory_order_relaxed) == 0) return;
+        }
+    }
+};
+
+// Convenience wrapper over the shared pool
+template <typename F>
+inline void parallelFor(size_t begin, size_t end, size_t grain, F&& f) {
+    ThreadPool::instance().parallelFor(begin, end, grain, std::forward<F>(f));
+}
+
+// Size thresholds below which Matrix operations stay single-threaded, so
+// the small matrices of the bundled problems never pay fork/join overhead
+constexpr size_t PARALLEL_ELEMENTWISE_MIN = 1 << 15;   // elements
+constexpr size_t PARALLEL_GEMM_MIN = 1 << 21;          // m * n * k
+
+#endif /* thread_pool_hpp */